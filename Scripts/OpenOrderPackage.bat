@@ -0,0 +1,74 @@
+@echo off
+rem Packages the game twice, once with the default container layout and once laid out in the file open order recorded
+rem from a headless load run, then compares startup time and bytes read of both.
+rem
+rem Usage: OpenOrderPackage.bat [EngineDir] [Runs]
+rem Each run starts a build twice: once cold, right after the OS standby list is flushed with Sysinternals RAMMap, and
+rem once warm, straight after. The runs are labelled default-cold, default-warm, ordered-cold and ordered-warm. Set
+rem RAMMAP to the path of RAMMap.exe if it is not on PATH. Flushing the standby list needs an elevated prompt.
+rem
+rem The recorded order is kept in Build\Windows\FileOpenOrder\GameOpenOrder.log, which staging picks up for the pak and
+rem IoStore containers. The cooker writes CookerOpenOrder.log to the same folder. Startup numbers come from
+rem UFPSStartupTimingSubsystem and end up in Saved\Benchmarks\Startup.csv of each packaged build.
+
+setlocal
+
+set ENGINE=%~1
+if "%ENGINE%"=="" set ENGINE=C:\Program Files\Epic Games\UE_5.5
+set RUNS=%~2
+if "%RUNS%"=="" set RUNS=3
+
+if not defined RAMMAP for %%R in (RAMMap.exe) do set RAMMAP=%%~$PATH:R
+if not exist "%RAMMAP%" (
+    echo RAMMap.exe was not found. Put it on PATH or set RAMMAP to its path, cold runs need it to flush the file cache.
+    exit /b 1
+)
+
+set ROOT=%~dp0..
+set PROJECT=%ROOT%\UntitledFpsGame.uproject
+rem Staged builds start from a bootstrap exe named after the game target
+set TARGET=Movement_Remake
+set ORDERDIR=%ROOT%\Build\Windows\FileOpenOrder
+set ARCHIVE=%ROOT%\Saved\OpenOrder
+set UAT="%ENGINE%\Engine\Build\BatchFiles\RunUAT.bat"
+set PACKAGEARGS=-project="%PROJECT%" -target=%TARGET% -platform=Win64 -clientconfig=Development -build -cook -stage -pak -iostore -compressed -archive
+
+rem Default layout, without a recorded game open order
+if exist "%ORDERDIR%\GameOpenOrder.log" del "%ORDERDIR%\GameOpenOrder.log"
+call %UAT% BuildCookRun %PACKAGEARGS% -archivedirectory="%ARCHIVE%\Default" || exit /b 1
+set DEFAULTGAME=%ARCHIVE%\Default\Windows\%TARGET%.exe
+if not exist "%DEFAULTGAME%" (
+    echo %DEFAULTGAME% was not staged
+    exit /b 1
+)
+
+rem Record the open order of a headless load of the default map
+"%DEFAULTGAME%" -nullrhi -nosound -unattended -fileopenlog -StartupBenchmark -StartupLabel=record
+if not exist "%ORDERDIR%" mkdir "%ORDERDIR%"
+for /r "%ARCHIVE%\Default" %%F in (GameOpenOrder*.log) do copy /y "%%F" "%ORDERDIR%\GameOpenOrder.log" >nul
+if not exist "%ORDERDIR%\GameOpenOrder.log" (
+    echo No GameOpenOrder.log was recorded
+    exit /b 1
+)
+
+rem Layout driven by the recorded order
+call %UAT% BuildCookRun %PACKAGEARGS% -archivedirectory="%ARCHIVE%\Ordered" || exit /b 1
+set ORDEREDGAME=%ARCHIVE%\Ordered\Windows\%TARGET%.exe
+if not exist "%ORDEREDGAME%" (
+    echo %ORDEREDGAME% was not staged
+    exit /b 1
+)
+
+for /l %%I in (1,1,%RUNS%) do (
+    "%RAMMAP%" -Et
+    "%DEFAULTGAME%" -nullrhi -nosound -unattended -StartupBenchmark -StartupLabel=default-cold
+    "%DEFAULTGAME%" -nullrhi -nosound -unattended -StartupBenchmark -StartupLabel=default-warm
+    "%RAMMAP%" -Et
+    "%ORDEREDGAME%" -nullrhi -nosound -unattended -StartupBenchmark -StartupLabel=ordered-cold
+    "%ORDEREDGAME%" -nullrhi -nosound -unattended -StartupBenchmark -StartupLabel=ordered-warm
+)
+
+for /r "%ARCHIVE%" %%F in (Startup.csv) do if exist "%%F" (
+    echo %%F
+    type "%%F"
+)
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AllocationCounter.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/UnrealMemory.h"
+
+#if !UE_BUILD_SHIPPING
+
+namespace
+{
+    // Number of counters currently open on this thread
+    thread_local int32 GOpenCounters = 0;
+    // Running totals for this thread, only advanced while a counter is open
+    thread_local int64 GAllocationNum = 0;
+    thread_local int64 GAllocationBytes = 0;
+
+    // Forwards everything to the allocator it replaced and counts Malloc/Realloc calls on counting threads
+    class FMallocCountingProxy final : public FMalloc
+    {
+    public:
+        explicit FMallocCountingProxy(FMalloc *InInner) : Inner(InInner)
+        {
+        }
+
+        virtual void *Malloc(SIZE_T Count, uint32 Alignment) override
+        {
+            Record(Count);
+            return Inner->Malloc(Count, Alignment);
+        }
+        virtual void *TryMalloc(SIZE_T Count, uint32 Alignment) override
+        {
+            Record(Count);
+            return Inner->TryMalloc(Count, Alignment);
+        }
+        virtual void *Realloc(void *Original, SIZE_T Count, uint32 Alignment) override
+        {
+            Record(Count);
+            return Inner->Realloc(Original, Count, Alignment);
+        }
+        virtual void *TryRealloc(void *Original, SIZE_T Count, uint32 Alignment) override
+        {
+            Record(Count);
+            return Inner->TryRealloc(Original, Count, Alignment);
+        }
+        virtual void Free(void *Original) override
+        {
+            Inner->Free(Original);
+        }
+        virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+        {
+            return Inner->QuantizeSize(Count, Alignment);
+        }
+        virtual bool GetAllocationSize(void *Original, SIZE_T &SizeOut) override
+        {
+            return Inner->GetAllocationSize(Original, SizeOut);
+        }
+        virtual void Trim(bool bTrimThreadCaches) override
+        {
+            Inner->Trim(bTrimThreadCaches);
+        }
+        virtual void SetupTLSCachesOnCurrentThread() override
+        {
+            Inner->SetupTLSCachesOnCurrentThread();
+        }
+        virtual void MarkTLSCachesAsUsedOnCurrentThread() override
+        {
+            Inner->MarkTLSCachesAsUsedOnCurrentThread();
+        }
+        virtual void MarkTLSCachesAsUnusedOnCurrentThread() override
+        {
+            Inner->MarkTLSCachesAsUnusedOnCurrentThread();
+        }
+        virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+        {
+            Inner->ClearAndDisableTLSCachesOnCurrentThread();
+        }
+        virtual void InitializeStatsMetadata() override
+        {
+            Inner->InitializeStatsMetadata();
+        }
+        virtual void UpdateStats() override
+        {
+            Inner->UpdateStats();
+        }
+        virtual void GetAllocatorStats(FGenericMemoryStats &OutStats) override
+        {
+            Inner->GetAllocatorStats(OutStats);
+        }
+        virtual void DumpAllocatorStats(FOutputDevice &Ar) override
+        {
+            Inner->DumpAllocatorStats(Ar);
+        }
+        virtual bool IsInternallyThreadSafe() const override
+        {
+            return Inner->IsInternallyThreadSafe();
+        }
+        virtual bool ValidateHeap() override
+        {
+            return Inner->ValidateHeap();
+        }
+        virtual const TCHAR *GetDescriptiveName() override
+        {
+            return Inner->GetDescriptiveName();
+        }
+
+    private:
+        static FORCEINLINE void Record(SIZE_T Size)
+        {
+            if (GOpenCounters > 0)
+            {
+                GAllocationNum++;
+                GAllocationBytes += Size;
+            }
+        }
+
+        FMalloc *Inner;
+    };
+
+    // Puts the counting proxy in front of GMalloc once. The proxy is never removed, since memory allocated through it
+    // may still be freed through it later.
+    void InstallCountingProxy()
+    {
+        static const bool bInstalled = []()
+        {
+            // Make sure GMalloc exists before wrapping it
+            FMemory::Free(FMemory::Malloc(1));
+            GMalloc = new FMallocCountingProxy(GMalloc);
+            return true;
+        }();
+    }
+} // namespace
+
+FScopedAllocationCounter::FScopedAllocationCounter()
+{
+    InstallCountingProxy();
+    GOpenCounters++;
+    StartNum = GAllocationNum;
+    StartBytes = GAllocationBytes;
+}
+
+FScopedAllocationCounter::~FScopedAllocationCounter()
+{
+    GOpenCounters--;
+}
+
+int64 FScopedAllocationCounter::Num() const
+{
+    return GAllocationNum - StartNum;
+}
+
+int64 FScopedAllocationCounter::Bytes() const
+{
+    return GAllocationBytes - StartBytes;
+}
+
+bool FScopedAllocationCounter::IsSupported()
+{
+    return true;
+}
+
+#else
+
+FScopedAllocationCounter::FScopedAllocationCounter()
+{
+}
+
+FScopedAllocationCounter::~FScopedAllocationCounter()
+{
+}
+
+int64 FScopedAllocationCounter::Num() const
+{
+    return 0;
+}
+
+int64 FScopedAllocationCounter::Bytes() const
+{
+    return 0;
+}
+
+bool FScopedAllocationCounter::IsSupported()
+{
+    return false;
+}
+
+#endif
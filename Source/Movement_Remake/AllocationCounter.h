@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Optional.h"
+
+// Counts heap allocations made on the calling thread while in scope.
+// Installs a forwarding proxy in front of GMalloc the first time it is used; the proxy only counts on threads that
+// currently have a counter open, so other threads pay a single thread local check per allocation.
+// Not available in shipping builds, where Num() always returns 0.
+class MOVEMENT_REMAKE_API FScopedAllocationCounter
+{
+public:
+    FScopedAllocationCounter();
+    ~FScopedAllocationCounter();
+
+    // Number of Malloc/Realloc calls made on this thread since the counter was opened
+    int64 Num() const;
+    // Number of bytes requested on this thread since the counter was opened
+    int64 Bytes() const;
+
+    // Returns true if allocations can be counted in this build
+    static bool IsSupported();
+
+private:
+    int64 StartNum = 0;
+    int64 StartBytes = 0;
+};
+
+// Adds the heap allocations made on the calling thread during its scope, or until Stop is called, to Total.
+// Does nothing when constructed disabled, so it can stay on hot paths behind a console variable.
+class FScopedAllocationTally
+{
+public:
+    FScopedAllocationTally(int64 &InTotal, bool bEnabled) : Total(InTotal)
+    {
+        if (bEnabled)
+        {
+            Counter.Emplace();
+        }
+    }
+    ~FScopedAllocationTally()
+    {
+        Stop();
+    }
+
+    void Stop()
+    {
+        if (Counter.IsSet())
+        {
+            Total += Counter->Num();
+            Counter.Reset();
+        }
+    }
+
+private:
+    int64 &Total;
+    TOptional<FScopedAllocationCounter> Counter;
+};
@@ -0,0 +1,449 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FPSBotController.h"
+#include "FPSCharacter.h"
+#include "FPSParkourNavLinks.h"
+#include "Movement_Remake.h"
+#include "Containers/Ticker.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/GameModeBase.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformTime.h"
+#include "NavigationSystem.h"
+
+AFPSBotController::AFPSBotController()
+{
+    // Bots count as players in the match
+    bWantsPlayerState = true;
+}
+
+double UFPSBotTickStats::ConsumeAverageTickSeconds()
+{
+    const double Average = Ticks > 0 ? FPlatformTime::ToSeconds64(TickCycles) / Ticks : 0;
+    TickCycles = 0;
+    Ticks = 0;
+    return Average;
+}
+
+void AFPSBotController::OnPossess(APawn *InPawn)
+{
+    Super::OnPossess(InPawn);
+
+    TActorIterator<AFPSParkourNavLinks> It(GetWorld());
+    ParkourLinks = It ? *It : nullptr;
+    TickStats = GetWorld()->GetSubsystem<UFPSBotTickStats>();
+    CurrentPath.Reset();
+    ActiveLink = INDEX_NONE;
+    NextPathRequestTime = 0;
+}
+
+void AFPSBotController::OnUnPossess()
+{
+    if (PendingQueryId != INVALID_NAVQUERYID)
+    {
+        if (UNavigationSystemV1 *NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+        {
+            NavSys->AbortAsyncFindPathRequest(PendingQueryId);
+        }
+        PendingQueryId = INVALID_NAVQUERYID;
+    }
+    CurrentPath.Reset();
+    Super::OnUnPossess();
+}
+
+void AFPSBotController::Tick(float DeltaTime)
+{
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    Super::Tick(DeltaTime);
+
+    AFPSCharacter *Character = Cast<AFPSCharacter>(GetPawn());
+    if (Character && !Character->IsPooled())
+    {
+        const double Now = GetWorld()->GetTimeSeconds();
+        if (CurrentPath.IsValid())
+        {
+            FollowPath(Character, Now);
+        }
+        else if (PendingQueryId == INVALID_NAVQUERYID && Now >= NextPathRequestTime)
+        {
+            NextPathRequestTime = Now + 1;
+            RequestPath();
+        }
+    }
+
+    if (UFPSBotTickStats *Stats = TickStats.Get())
+    {
+        Stats->AddTick(FPlatformTime::Cycles64() - StartCycles);
+    }
+}
+
+// Picks a random goal and asks for a path to it, the path is searched on a worker thread
+void AFPSBotController::RequestPath()
+{
+    UNavigationSystemV1 *NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+    ANavigationData *NavData = NavSys ? NavSys->GetNavDataForProps(GetNavAgentPropertiesRef()) : nullptr;
+    if (!NavData)
+    {
+        return;
+    }
+    const FSharedConstNavQueryFilter Filter =
+        UNavigationQueryFilter::GetQueryFilter(*NavData, this, UFPSParkourQueryFilter::StaticClass());
+    const FVector Start = GetPawn()->GetNavAgentLocation();
+    FNavLocation Goal;
+    if (!NavSys->GetRandomReachablePointInRadius(Start, WanderRadius, Goal, NavData, Filter))
+    {
+        return;
+    }
+    PendingQueryId = NavSys->FindPathAsync(GetNavAgentPropertiesRef(),
+                                           FPathFindingQuery(this, *NavData, Start, Goal.Location, Filter),
+                                           FNavPathQueryDelegate::CreateUObject(this, &AFPSBotController::OnPathFound));
+}
+
+void AFPSBotController::OnPathFound(uint32 QueryId, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path)
+{
+    if (QueryId != PendingQueryId)
+    {
+        return;
+    }
+    PendingQueryId = INVALID_NAVQUERYID;
+    if (Result == ENavigationQueryResult::Success && Path.IsValid() && Path->GetPathPoints().Num() > 1)
+    {
+        CurrentPath = Path;
+        // The first point is where the bot already is
+        NextPathPoint = 1;
+        ActiveLink = INDEX_NONE;
+        ClosestDistance = MAX_flt;
+        LastProgressTime = GetWorld()->GetTimeSeconds();
+    }
+}
+
+void AFPSBotController::FollowPath(AFPSCharacter *Character, double Now)
+{
+    const TArray<FNavPathPoint> &Points = CurrentPath->GetPathPoints();
+    bool bMoveFailed = false;
+    if (ActiveLink != INDEX_NONE)
+    {
+        bMoveFailed = Now > LinkMoveEndTime && Character->GetCharacterMovement()->IsMovingOnGround();
+    }
+    else if (Points.IsValidIndex(NextPathPoint))
+    {
+        // A walking leg fails once the bot stops getting closer to the point, for example when something blocks it
+        const float Distance = FVector::Dist2D(Character->GetNavAgentLocation(), Points[NextPathPoint].Location);
+        if (Distance < ClosestDistance - AcceptanceRadius * .25f)
+        {
+            ClosestDistance = Distance;
+            LastProgressTime = Now;
+        }
+        bMoveFailed = Now - LastProgressTime > WalkProgressTimeout;
+    }
+    if (NextPathPoint >= Points.Num() || bMoveFailed)
+    {
+        // Tick asks for a new path once there is none
+        CurrentPath.Reset();
+        ActiveLink = INDEX_NONE;
+        return;
+    }
+
+    if (ActiveLink != INDEX_NONE)
+    {
+        if (WallJumpDelay >= 0 && Character->IsWallRunning())
+        {
+            PendingJumps = 1;
+            NextJumpTime = Now + WallJumpDelay;
+            WallJumpDelay = -1;
+        }
+        if (PendingJumps > 0 && Now >= NextJumpTime)
+        {
+            Character->ApplyJumpInput();
+            PendingJumps--;
+            NextJumpTime = Now + JumpInterval;
+        }
+        if (!bLinkViaReached)
+        {
+            bLinkViaReached = Character->IsWallRunning() ||
+                              FVector::DistSquared2D(Character->GetActorLocation(), LinkVia) <
+                                  AcceptanceRadius * AcceptanceRadius;
+        }
+    }
+
+    const FVector Target = Points[NextPathPoint].Location;
+    if (FVector::DistSquared2D(Character->GetNavAgentLocation(), Target) < AcceptanceRadius * AcceptanceRadius)
+    {
+        ActiveLink = INDEX_NONE;
+        // A point followed by the end of a parkour link is where the move starts
+        if (AFPSParkourNavLinks *Links = ParkourLinks.Get(); Links && Points.IsValidIndex(NextPathPoint + 1))
+        {
+            const int32 Link = Links->FindLink(Target, Points[NextPathPoint + 1].Location, AcceptanceRadius);
+            if (Link != INDEX_NONE)
+            {
+                StartLinkMove(Character, Link, Now);
+            }
+        }
+        NextPathPoint++;
+        ClosestDistance = MAX_flt;
+        LastProgressTime = Now;
+        return;
+    }
+    SteerToward(Character, ActiveLink != INDEX_NONE && !bLinkViaReached ? LinkVia : Target);
+}
+
+// Presses jump the way a player would for the move the link stands for
+void AFPSBotController::StartLinkMove(AFPSCharacter *Character, int32 Link, double Now)
+{
+    const AFPSParkourNavLinks *Links = ParkourLinks.Get();
+    const FParkourMoveLimits Limits = FParkourMoveLimits::FromCharacter(*Character, GetWorld()->GetGravityZ());
+    const UClass *AreaClass = Links->GetLinkArea(Link);
+
+    ActiveLink = Link;
+    LinkVia = Links->GetLinkViaPoint(Link);
+    bLinkViaReached = false;
+    PendingJumps = 0;
+    WallJumpDelay = -1;
+    Character->ApplyJumpInput();
+
+    float MoveTime = 0;
+    if (AreaClass == UFPSNavArea_DoubleJump::StaticClass())
+    {
+        // Every air jump at the apex of the jump before
+        PendingJumps = Limits.AirJumps;
+        JumpInterval = Limits.AirJumpDelay;
+        NextJumpTime = Now + JumpInterval;
+        MoveTime = Limits.DoubleJumpTime;
+    }
+    else if (AreaClass == UFPSNavArea_WallJump::StaticClass())
+    {
+        WallJumpDelay = Limits.WallRunTime * .5f;
+        MoveTime = Limits.WallRunTime + Limits.WallJumpTime;
+    }
+    else
+    {
+        MoveTime = Limits.WallRunTime + Limits.AirJumpDelay;
+    }
+    LinkMoveEndTime = Now + MoveTime + LinkMoveSlack;
+}
+
+// Faces the target and walks forward, the same input a player gives by looking and holding forward
+void AFPSBotController::SteerToward(AFPSCharacter *Character, const FVector &Target)
+{
+    SetFocalPoint(Target);
+    const FVector Direction = (Target - Character->GetActorLocation()).GetSafeNormal2D();
+    Character->ApplyWalkInput(FVector(FVector::DotProduct(Direction, Character->GetActorRightVector()),
+                                      FVector::DotProduct(Direction, Character->GetActorForwardVector()), 0));
+}
+
+// Spawns bots and has the game mode give them characters, the same way players get theirs
+static int32 AddBots(UWorld *World, int32 Count)
+{
+    AGameModeBase *GameMode = World ? World->GetAuthGameMode() : nullptr;
+    if (!GameMode)
+    {
+        UE_LOG(LogMovementRemake, Warning, TEXT("Bots can only be added on the server"));
+        return 0;
+    }
+    int32 Added = 0;
+    for (int32 Index = 0; Index < Count; Index++)
+    {
+        if (AFPSBotController *Bot = World->SpawnActor<AFPSBotController>())
+        {
+            GameMode->RestartPlayer(Bot);
+            Added++;
+        }
+    }
+    return Added;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs AddBotsCommand(
+    TEXT("fps.Bots.Add"), TEXT("Adds bots to the match. Usage: fps.Bots.Add [Count]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString> &Args, UWorld *World) {
+        const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1;
+        UE_LOG(LogMovementRemake, Log, TEXT("Added %d bots"), AddBots(World, Count));
+    }));
+
+// fps.Bots.BenchPaths [Queries] times random parkour path queries, first on the game thread to get the raw query rate,
+// then all at once through the async path the bots use. Headless:
+// UnrealEditor-Cmd <Project> <Map> -game -nullrhi -nosound -ExecCmds="fps.Bots.BenchPaths 2000"
+static void BenchPaths(const TArray<FString> &Args, UWorld *World)
+{
+    const int32 Queries = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000;
+    UNavigationSystemV1 *NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+    ANavigationData *NavData = NavSys ? NavSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate) : nullptr;
+    if (!NavData)
+    {
+        UE_LOG(LogMovementRemake, Warning, TEXT("fps.Bots.BenchPaths needs a level with navigation"));
+        return;
+    }
+    const FSharedConstNavQueryFilter Filter =
+        UNavigationQueryFilter::GetQueryFilter(*NavData, nullptr, UFPSParkourQueryFilter::StaticClass());
+
+    // Endpoints are picked up front so only the searches are timed
+    TArray<TPair<FVector, FVector>> Endpoints;
+    Endpoints.Reserve(Queries);
+    for (int32 Index = 0; Index < Queries; Index++)
+    {
+        FNavLocation Start, End;
+        if (NavSys->GetRandomPoint(Start, NavData, Filter) && NavSys->GetRandomPoint(End, NavData, Filter))
+        {
+            Endpoints.Emplace(Start.Location, End.Location);
+        }
+    }
+    if (Endpoints.Num() == 0)
+    {
+        return;
+    }
+
+    int32 Found = 0;
+    uint64 StartCycles = FPlatformTime::Cycles64();
+    for (const TPair<FVector, FVector> &Endpoint : Endpoints)
+    {
+        Found += NavSys->FindPathSync(FPathFindingQuery(World, *NavData, Endpoint.Key, Endpoint.Value, Filter))
+                     .IsSuccessful();
+    }
+    const double SyncSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+    UE_LOG(LogMovementRemake, Display, TEXT("Paths: %d sync queries, %d found, %.0f queries/s on the game thread"),
+           Endpoints.Num(), Found, Endpoints.Num() / FMath::Max(SyncSeconds, 1e-9));
+
+    // Async results come back on the game thread, so this includes the frames spent waiting for them
+    struct FAsyncBench
+    {
+        int32 Total = 0;
+        int32 Pending = 0;
+        int32 Found = 0;
+        uint64 StartCycles = 0;
+    };
+    TSharedRef<FAsyncBench> Bench = MakeShared<FAsyncBench>();
+    Bench->Total = Bench->Pending = Endpoints.Num();
+    Bench->StartCycles = FPlatformTime::Cycles64();
+    for (const TPair<FVector, FVector> &Endpoint : Endpoints)
+    {
+        NavSys->FindPathAsync(
+            NavData->GetConfig(), FPathFindingQuery(World, *NavData, Endpoint.Key, Endpoint.Value, Filter),
+            FNavPathQueryDelegate::CreateLambda(
+                [Bench](uint32 QueryId, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path) {
+                    Bench->Found += Result == ENavigationQueryResult::Success;
+                    if (--Bench->Pending == 0)
+                    {
+                        const double Seconds =
+                            FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - Bench->StartCycles);
+                        UE_LOG(LogMovementRemake, Display,
+                               TEXT("Paths: async batch of %d found %d in %.2f ms, %.0f queries/s"), Bench->Total,
+                               Bench->Found, Seconds * 1000, Bench->Total / FMath::Max(Seconds, 1e-9));
+                    }
+                }));
+    }
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchPathsCommand(
+    TEXT("fps.Bots.BenchPaths"), TEXT("Measures parkour path queries per second. Usage: fps.Bots.BenchPaths [Queries]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchPaths));
+
+// fps.Bots.Ramp [MaxBots] [BudgetMs] [quit] adds bots a few at a time and reports how many the server kept under its
+// tick budget, counting the whole world tick so bot characters and movement are included. On a dedicated server:
+// <Project>Server <Map> -nullrhi -ExecCmds="fps.Bots.BenchPaths 2000, fps.Bots.Ramp 256 16 quit"
+class FBotRamp
+{
+public:
+    static void Start(const TArray<FString> &Args, UWorld *World)
+    {
+        if (Instance.IsValid() || !World)
+        {
+            return;
+        }
+        Instance = MakeUnique<FBotRamp>();
+        FBotRamp &Ramp = *Instance;
+        Ramp.World = World;
+        Ramp.MaxBots = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 128;
+        Ramp.BudgetMs = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 16.f;
+        Ramp.bQuit = Args.Contains(TEXT("quit"));
+        Ramp.TickStartHandle = FWorldDelegates::OnWorldTickStart.AddLambda(
+            [&Ramp](UWorld *TickWorld, ELevelTick, float) {
+                if (TickWorld == Ramp.World.Get())
+                {
+                    Ramp.TickStartCycles = FPlatformTime::Cycles64();
+                }
+            });
+        Ramp.PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddLambda(
+            [&Ramp](UWorld *TickWorld, ELevelTick, float) {
+                if (TickWorld == Ramp.World.Get() && Ramp.TickStartCycles != 0)
+                {
+                    Ramp.TickCycles += FPlatformTime::Cycles64() - Ramp.TickStartCycles;
+                    Ramp.Ticks++;
+                    Ramp.TickStartCycles = 0;
+                }
+            });
+        FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(&Ramp, &FBotRamp::Step), StepSeconds);
+        // Drops bot ticks from before the ramp
+        if (UFPSBotTickStats *Stats = World->GetSubsystem<UFPSBotTickStats>())
+        {
+            Stats->ConsumeAverageTickSeconds();
+        }
+    }
+
+private:
+    // Seconds each bot count is measured for, long enough for bots to get paths and start moving
+    static constexpr float StepSeconds = 3.f;
+    static constexpr int32 BotsPerStep = 8;
+    static TUniquePtr<FBotRamp> Instance;
+
+    bool Step(float DeltaTime)
+    {
+        const double TickMs = Ticks > 0 ? FPlatformTime::ToMilliseconds64(TickCycles) / Ticks : 0;
+        UFPSBotTickStats *Stats = World.IsValid() ? World->GetSubsystem<UFPSBotTickStats>() : nullptr;
+        const double BotUs = Stats ? Stats->ConsumeAverageTickSeconds() * 1e6 : 0;
+        TickCycles = 0;
+        Ticks = 0;
+        if (Bots > 0)
+        {
+            UE_LOG(LogMovementRemake, Display, TEXT("Bots: %d, world tick %.2f ms, bot controller tick %.1f us"), Bots,
+                   TickMs, BotUs);
+        }
+
+        const bool bOverBudget = TickMs > BudgetMs;
+        if (bOverBudget || Bots >= MaxBots || !World.IsValid())
+        {
+            const int32 Sustained = bOverBudget ? Bots - BotsPerStep : Bots;
+            UE_LOG(LogMovementRemake, Display, TEXT("Bots: sustained %d bots within %.1f ms per tick%s"),
+                   FMath::Max(Sustained, 0), BudgetMs, bOverBudget ? TEXT("") : TEXT(" (stopped at the maximum)"));
+            Finish();
+            return false;
+        }
+        Bots += AddBots(World.Get(), FMath::Min(BotsPerStep, MaxBots - Bots));
+        return true;
+    }
+
+    void Finish()
+    {
+        FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+        FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+        if (bQuit)
+        {
+            FPlatformMisc::RequestExit(false, TEXT("fps.Bots.Ramp"));
+        }
+        // Deferred so the ticker isn't destroyed while it is running
+        FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([](float) {
+            Instance.Reset();
+            return false;
+        }));
+    }
+
+    TWeakObjectPtr<UWorld> World;
+    int32 MaxBots = 0;
+    float BudgetMs = 0;
+    bool bQuit = false;
+    int32 Bots = 0;
+    uint64 TickStartCycles = 0;
+    uint64 TickCycles = 0;
+    int32 Ticks = 0;
+    FDelegateHandle TickStartHandle;
+    FDelegateHandle PostActorTickHandle;
+};
+
+TUniquePtr<FBotRamp> FBotRamp::Instance;
+
+static FAutoConsoleCommandWithWorldAndArgs BotRampCommand(
+    TEXT("fps.Bots.Ramp"),
+    TEXT("Adds bots until the world tick goes over budget and logs how many were sustained. Usage: fps.Bots.Ramp "
+         "[MaxBots] [BudgetMs] [quit]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&FBotRamp::Start));
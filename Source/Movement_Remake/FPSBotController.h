@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "NavigationData.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FPSBotController.generated.h"
+
+class AFPSCharacter;
+class AFPSParkourNavLinks;
+class UFPSBotTickStats;
+
+/**
+ * Game thread time spent in the Tick of the bots in one world, read by fps.Bots.Ramp
+ */
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSBotTickStats : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    void AddTick(uint64 Cycles)
+    {
+        TickCycles += Cycles;
+        Ticks++;
+    }
+    // Average time of a bot's Tick since the last call, in seconds
+    double ConsumeAverageTickSeconds();
+
+private:
+    uint64 TickCycles = 0;
+    uint64 Ticks = 0;
+};
+
+/**
+ * Server bot that wanders the level along paths found asynchronously with UFPSParkourQueryFilter, so they can use
+ * AFPSParkourNavLinks. The character is moved only through its Apply*Input functions, the same ones player input uses.
+ * Bots are added with fps.Bots.Add, fps.Bots.BenchPaths and fps.Bots.Ramp measure how many the server can handle.
+ */
+UCLASS()
+class MOVEMENT_REMAKE_API AFPSBotController : public AAIController
+{
+    GENERATED_BODY()
+
+public:
+    AFPSBotController();
+
+    virtual void Tick(float DeltaTime) override;
+
+protected:
+    virtual void OnPossess(APawn *InPawn) override;
+    virtual void OnUnPossess() override;
+
+private:
+    void RequestPath();
+    void OnPathFound(uint32 QueryId, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path);
+    void FollowPath(AFPSCharacter *Character, double Now);
+    void StartLinkMove(AFPSCharacter *Character, int32 Link, double Now);
+    void SteerToward(AFPSCharacter *Character, const FVector &Target);
+
+    // How far away wander goals are picked
+    UPROPERTY(EditAnywhere, Category = "Bot")
+    float WanderRadius = 5000.f;
+    // Distance at which a path point counts as reached
+    UPROPERTY(EditAnywhere, Category = "Bot")
+    float AcceptanceRadius = 80.f;
+    // Seconds a parkour move may take beyond its expected time before the path is given up on
+    UPROPERTY(EditAnywhere, Category = "Bot")
+    float LinkMoveSlack = 1.f;
+    // Seconds a walking bot may go without getting closer to the next path point before the path is given up on
+    UPROPERTY(EditAnywhere, Category = "Bot")
+    float WalkProgressTimeout = 2.f;
+
+    TWeakObjectPtr<AFPSParkourNavLinks> ParkourLinks;
+    TWeakObjectPtr<UFPSBotTickStats> TickStats;
+    FNavPathSharedPtr CurrentPath;
+    int32 NextPathPoint = 0;
+    uint32 PendingQueryId = INVALID_NAVQUERYID;
+    // World time before which no new path is requested, so failed queries aren't repeated every tick
+    double NextPathRequestTime = 0;
+    // Closest the bot has come to the next path point while walking, and the world time it last got closer
+    float ClosestDistance = 0;
+    double LastProgressTime = 0;
+
+    // Parkour move in progress, INDEX_NONE when walking
+    int32 ActiveLink = INDEX_NONE;
+    double LinkMoveEndTime = 0;
+    // Point steered toward until it is reached or the character is on the wall
+    FVector LinkVia = FVector::ZeroVector;
+    bool bLinkViaReached = false;
+    // Jump presses still to make during the move and when the next one is made
+    int32 PendingJumps = 0;
+    double NextJumpTime = 0;
+    double JumpInterval = 0;
+    // Wall jumps are pressed this long after the character starts running on the wall, negative when not pending
+    double WallJumpDelay = -1;
+};
@@ -1,6 +1,11 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "FPSCharacter.h"
+#include "AllocationCounter.h"
+#include "FPSCharacterMovementComponent.h"
+#include "FPSHitchCaptureSubsystem.h"
+#include "FPSMetricsSubsystem.h"
+#include "Movement_Remake.h"
 #include "CollisionQueryParams.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/SkeletalMeshComponent.h"
@@ -8,11 +13,11 @@
 #include "Engine/Engine.h"
 #include "Engine/EngineTypes.h"
 #include "Engine/HitResult.h"
-#include "Engine/TimerHandle.h"
 #include "EnhancedInputComponent.h"
 #include "GameFramework/Character.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
 #include "HAL/Platform.h"
 #include "InputTriggers.h"
 #include "Kismet/GameplayStatics.h"
@@ -20,13 +25,23 @@
 #include "Math/MathFwd.h"
 #include "Math/UnrealMathUtility.h"
 #include "Misc/CoreMiscDefines.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 #include "Templates/Casts.h"
 #include "Delegates/Delegate.h"
-#include "TimerManager.h"
 #include <cmath>
 
+static TAutoConsoleVariable<bool> CVarMovementDebugMessages(
+    TEXT("fps.Movement.DebugMessages"), false,
+    TEXT("Shows on screen debug messages for wall runs, wall jumps and air strafing"));
+static TAutoConsoleVariable<bool> CVarMovementAllocCheck(
+    TEXT("fps.Movement.AllocCheck"), false,
+    TEXT("Counts heap allocations in Tick and the input handlers and warns when a steady slide, wall run or air frame "
+         "allocates"));
+
 // Sets default values
-AFPSCharacter::AFPSCharacter()
+AFPSCharacter::AFPSCharacter(const FObjectInitializer &ObjectInitializer)
+    : Super(ObjectInitializer.SetDefaultSubobjectClass<UFPSCharacterMovementComponent>(
+          ACharacter::CharacterMovementComponentName))
 {
     // Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need
     // it.
@@ -78,12 +93,129 @@ void AFPSCharacter::BeginPlay()
     CrouchScale *= NormalScale.Z;
     // Set player scale to default scale
     SetActorScale3D(NormalScale);
+
+    // Dedicated servers never render this character, so camera and mesh components don't need to tick
+    bCosmeticsEnabled = ShouldRunCosmetics();
+    if (!bCosmeticsEnabled)
+    {
+        SpringArm->SetComponentTickEnabled(false);
+        CameraComp->SetComponentTickEnabled(false);
+        GetMesh()->SetComponentTickEnabled(false);
+    }
+    // Component ticks are registered in BeginPlay, so a character pooled before that is pooled again here
+    if (bPooled)
+    {
+        ApplyPooledState();
+    }
+}
+
+// The server resets a pooled character when it hands it out, but the movement state is driven by input on the owning
+// client, so the client's copy is reset here when the character is possessed again
+void AFPSCharacter::PawnClientRestart()
+{
+    Super::PawnClientRestart();
+    ResetMovementState();
+}
+
+// Resets movement state so a pooled character can be reused without spawning a new one
+void AFPSCharacter::ResetMovementState()
+{
+    bIsCrouching = false;
+    bAppliedSlideForce = false;
+    bIsWallrunning = false;
+    CurrentWall = nullptr;
+    WallNormalVector = FVector::ZeroVector;
+    WallPerpendicularNormalVector = FVector::ZeroVector;
+    WallRunTiltDirection = 0;
+    AddVelocityMag = SlideForce;
+    WalkingInput = FVector::ZeroVector;
+    AirJumpCount = AirJumpMax;
+    AirControlResetTime = 0;
+    WallRunTimeout = 0;
+    FrameAllocations = 0;
+    LastMovementState = 0;
+
+    // Same values StopCrouch and OnJumpLand go back to
+    UCharacterMovementComponent *Movement = GetCharacterMovement();
+    Movement->StopMovementImmediately();
+    Movement->GroundFriction = 8.0f;
+    Movement->BrakingFrictionFactor = 2.0f;
+    Movement->MaxWalkSpeed = WalkSpeed;
+    Movement->GravityScale = 1;
+    Movement->AirControl = .7;
+
+    SetActorScale3D(NormalScale);
+    FRotator CameraTilt = CameraComp->GetRelativeRotation();
+    CameraTilt.Roll = 0;
+    CameraComp->SetRelativeRotation(CameraTilt);
+}
+// Puts the character in or takes it out of the character pool. Pooling is server side only: a hidden character without
+// collision isn't net relevant, so clients close its channel and get a new actor when it is handed out again.
+void AFPSCharacter::SetPooled(bool bInPooled)
+{
+    bPooled = bInPooled;
+    ApplyPooledState();
+}
+void AFPSCharacter::ApplyPooledState()
+{
+    SetActorHiddenInGame(bPooled);
+    SetActorEnableCollision(!bPooled);
+    SetActorTickEnabled(!bPooled);
+    GetCharacterMovement()->SetComponentTickEnabled(!bPooled);
+    if (bPooled)
+    {
+        GetCharacterMovement()->StopMovementImmediately();
+        GetCharacterMovement()->DisableMovement();
+    }
+    else
+    {
+        GetCharacterMovement()->SetDefaultMovementMode();
+    }
+}
+void AFPSCharacter::CountClientMovementEvent(EFPSMetric Metric)
+{
+    UFPSMetricsSubsystem::Increment(this, Metric);
+    if (!HasAuthority() && IsLocallyControlled())
+    {
+        ServerCountMovementEvent((uint8)Metric);
+    }
+}
+void AFPSCharacter::ServerCountMovementEvent_Implementation(uint8 Metric)
+{
+    if (Metric == (uint8)EFPSMetric::SlideStart || Metric == (uint8)EFPSMetric::EffectSpawn)
+    {
+        UFPSMetricsSubsystem::Increment(this, (EFPSMetric)Metric);
+    }
+}
+// Returns false on dedicated servers, where camera tilt, particles and on screen messages are skipped
+bool AFPSCharacter::ShouldRunCosmetics() const
+{
+#if UE_SERVER
+    return false;
+#else
+    return !IsNetMode(NM_DedicatedServer);
+#endif
 }
 
 // Called every frame
 void AFPSCharacter::Tick(float DeltaTime)
 {
+    LLM_SCOPE_BYTAG(FPSMovement);
+    FScopedAllocationTally Allocations(FrameAllocations, CVarMovementAllocCheck.GetValueOnGameThread());
+
     Super::Tick(DeltaTime);
+    // Timeouts that would otherwise need a timer delegate per wall hit
+    const double Now = GetWorld()->GetTimeSeconds();
+    if (WallRunTimeout > 0 && Now >= WallRunTimeout)
+    {
+        WallRunTimeout = 0;
+        StopWallRun();
+    }
+    if (AirControlResetTime > 0 && Now >= AirControlResetTime)
+    {
+        AirControlResetTime = 0;
+        GetCharacterMovement()->AirControl = 0.7;
+    }
     if (bIsCrouching)
     {
         // Makes smoothly camera tilt when sliding
@@ -96,14 +228,7 @@ void AFPSCharacter::Tick(float DeltaTime)
         if (GetCharacterMovement()->IsMovingOnGround() && GetCharacterMovement()->IsJumpAllowed())
         {
             // Applies force to speed up player when sliding down slopes
-
-            // Projected vector on slope
-            FVector ProjectedVector =
-                FVector::VectorPlaneProject(FVector::DownVector, GetCharacterMovement()->CurrentFloor.HitResult.Normal);
-            // Adds downwards force based off player's allignment off slope
-            GetCharacterMovement()->Velocity +=
-                FMath::Abs(FVector::DotProduct(GetActorForwardVector(), ProjectedVector.GetSafeNormal2D())) *
-                ProjectedVector * DeltaTime * 10000.f;
+            SlopeSlide(DeltaTime);
             // Applies gradual slide force to counter friction
             GradualSlide(DeltaTime);
         }
@@ -123,6 +248,62 @@ void AFPSCharacter::Tick(float DeltaTime)
         WallRun(DeltaTime);
         SmoothCameraTilt(WallRunTiltDirection * WallRunCameraTiltAngle, WallRunTransitionSpeed, DeltaTime);
     }
+
+    Allocations.Stop();
+    CheckFrameAllocations();
+    UFPSHitchCaptureSubsystem::CountMovement(this, bIsWallrunning, bIsCrouching && bAppliedSlideForce,
+                                             GetCharacterMovement()->IsFalling());
+}
+
+FString AFPSCharacter::DescribeMovementState() const
+{
+    const UCharacterMovementComponent *Movement = GetCharacterMovement();
+    return FString::Printf(TEXT("%s controller=%s location=(%s) velocity=(%s) mode=%s crouching=%d sliding=%d "
+                                "wallrunning=%d airjumps=%d gravityscale=%.2f aircontrol=%.2f"),
+                           *GetName(), *GetNameSafe(GetController()), *GetActorLocation().ToCompactString(),
+                           *Movement->Velocity.ToCompactString(), *Movement->GetMovementName(), bIsCrouching,
+                           bAppliedSlideForce, bIsWallrunning, AirJumpCount, Movement->GravityScale,
+                           Movement->AirControl);
+}
+
+// Warns when a frame that stayed in the same slide, wall run or air state as the last one allocated on the heap
+void AFPSCharacter::CheckFrameAllocations()
+{
+    const UCharacterMovementComponent *Movement = GetCharacterMovement();
+    const uint32 MovementState = uint32(bIsCrouching) | uint32(bAppliedSlideForce) << 1 | uint32(bIsWallrunning) << 2 |
+                                 uint32(Movement->MovementMode.GetValue()) << 3 | uint32(AirJumpCount) << 8;
+    const bool bSteadyState = MovementState == LastMovementState;
+    LastMovementState = MovementState;
+
+    if (FrameAllocations > 0 && bSteadyState)
+    {
+        const TCHAR *StateName = nullptr;
+        if (bIsWallrunning)
+        {
+            StateName = TEXT("wall run");
+        }
+        else if (bIsCrouching && bAppliedSlideForce && Movement->IsMovingOnGround())
+        {
+            StateName = TEXT("slide");
+        }
+        else if (Movement->IsFalling())
+        {
+            StateName = TEXT("air");
+        }
+        if (StateName)
+        {
+            UE_LOG(LogMovementRemake, Warning, TEXT("%s: %lld heap allocations in a steady %s frame"), *GetName(),
+                   FrameAllocations, StateName);
+            SteadyFrameAllocations += FrameAllocations;
+        }
+    }
+    FrameAllocations = 0;
+}
+
+// Whether the on screen movement debug messages should be shown
+bool AFPSCharacter::ShowDebugMessages() const
+{
+    return bCosmeticsEnabled && CVarMovementDebugMessages.GetValueOnGameThread();
 }
 
 // Called to bind functionality to input
@@ -135,23 +316,33 @@ void AFPSCharacter::SetupPlayerInputComponent(UInputComponent *PlayerInputCompon
         EnhancedInput->BindAction(WalkAction, ETriggerEvent::Triggered, this, &AFPSCharacter::Walk);
         // Binds look function to look action
         EnhancedInput->BindAction(LookAction, ETriggerEvent::Triggered, this, &AFPSCharacter::Look);
-        // Binds jump function to built in jump function
+        // Binds a jump press to the same jump, wall jump and air jump sequence bots use
+        EnhancedInput->BindAction(JumpAction, ETriggerEvent::Started, this, &AFPSCharacter::ApplyJumpInput);
+        // Holding jump keeps pressing the built in jump, so the character jumps again as it lands
         EnhancedInput->BindAction(JumpAction, ETriggerEvent::Triggered, this, &ACharacter::Jump);
-        EnhancedInput->BindAction(JumpAction, ETriggerEvent::Started, this, &AFPSCharacter::WallJump);
-        EnhancedInput->BindAction(JumpAction, ETriggerEvent::Started, this, &AFPSCharacter::AirJump);
         // Binds bIsCrouching to startcrouch and stopcrouch function
         EnhancedInput->BindAction(CrouchAction, ETriggerEvent::Started, this, &AFPSCharacter::StartCrouch);
         EnhancedInput->BindAction(CrouchAction, ETriggerEvent::Completed, this, &AFPSCharacter::StopCrouch);
 
         // Screen Text for debugging
-        GEngine->AddOnScreenDebugMessage(1, 3.f, FColor::Green, TEXT("Input Actions Binded"));
+        if (ShowDebugMessages())
+        {
+            GEngine->AddOnScreenDebugMessage(1, 3.f, FColor::Green, TEXT("Input Actions Binded"));
+        }
     }
 }
 // Function for walking functionality
 void AFPSCharacter::Walk(const FInputActionInstance &Instance)
+{
+    LLM_SCOPE_BYTAG(FPSMovement);
+    FScopedAllocationTally Allocations(FrameAllocations, CVarMovementAllocCheck.GetValueOnGameThread());
+    ApplyWalkInput(Instance.GetValue().Get<FVector>());
+}
+// Moves the character from a walk input where X is right and Y is forward
+void AFPSCharacter::ApplyWalkInput(const FVector &Input)
 {
     // Gets value of input
-    WalkingInput = Instance.GetValue().Get<FVector>() * GetCharacterMovement()->MaxWalkSpeed;
+    WalkingInput = Input * GetCharacterMovement()->MaxWalkSpeed;
     WalkingInput = WalkingInput.X * GetActorRightVector() + WalkingInput.Y * GetActorForwardVector();
     // Adds input corresponding to character's forward and right vector
     AddMovementInput(WalkingInput);
@@ -170,7 +361,10 @@ void AFPSCharacter::Walk(const FInputActionInstance &Instance)
 void AFPSCharacter::AirAccelerate(FVector WishVelocity)
 {
     // Debug text
-    GEngine->AddOnScreenDebugMessage(INDEX_NONE, 5, FColor::Emerald, TEXT("HELLO"));
+    if (ShowDebugMessages())
+    {
+        GEngine->AddOnScreenDebugMessage(INDEX_NONE, 5, FColor::Emerald, TEXT("HELLO"));
+    }
 
     float WishSpeed, CurrentSpeed, AddSpeed, AccelSpeed;
 
@@ -197,6 +391,8 @@ void AFPSCharacter::AirAccelerate(FVector WishVelocity)
 // Function for player camera rotation
 void AFPSCharacter::Look(const FInputActionInstance &Instance)
 {
+    LLM_SCOPE_BYTAG(FPSMovement);
+    FScopedAllocationTally Allocations(FrameAllocations, CVarMovementAllocCheck.GetValueOnGameThread());
     FVector2D Input = Instance.GetValue().Get<FVector2D>();
     AddControllerPitchInput(Input.Y);
     AddControllerYawInput(Input.X);
@@ -207,33 +403,48 @@ void AFPSCharacter::Look(const FInputActionInstance &Instance)
 // Starts crouching
 void AFPSCharacter::StartCrouch(const FInputActionInstance &Instance)
 {
-    // SetActorScale3D(CrouchScale);
-    // FVector NewLocation = GetActorLocation();
-    // NewLocation.Z -= NormalScale.Z - CrouchScale.Z;
-    // SetActorLocation(NewLocation);
+    LLM_SCOPE_BYTAG(FPSMovement);
+    FScopedAllocationTally Allocations(FrameAllocations, CVarMovementAllocCheck.GetValueOnGameThread());
+    ApplyCrouchInput(true);
+}
+// Stops Crouching
+void AFPSCharacter::StopCrouch(const FInputActionInstance &Instance)
+{
+    LLM_SCOPE_BYTAG(FPSMovement);
+    FScopedAllocationTally Allocations(FrameAllocations, CVarMovementAllocCheck.GetValueOnGameThread());
+    ApplyCrouchInput(false);
+}
+// Crouches and slides while pressed, goes back to walking when released
+void AFPSCharacter::ApplyCrouchInput(bool bPressed)
+{
+    if (bPressed)
+    {
+        // SetActorScale3D(CrouchScale);
+        // FVector NewLocation = GetActorLocation();
+        // NewLocation.Z -= NormalScale.Z - CrouchScale.Z;
+        // SetActorLocation(NewLocation);
 
-    bIsCrouching = true;
+        bIsCrouching = true;
 
-    // Adds message containing character velocity
-    // GEngine->AddOnScreenDebugMessage(0, 5.f, FColor::Green,
-    //                                  FString::Printf(TEXT("Velocity = %d"),
-    //                                  GetCharacterMovement()->Velocity.SizeSquared2D()));
+        // Adds message containing character velocity
+        // GEngine->AddOnScreenDebugMessage(0, 5.f, FColor::Green,
+        //                                  FString::Printf(TEXT("Velocity = %d"),
+        //                                  GetCharacterMovement()->Velocity.SizeSquared2D()));
 
-    // Sets ground friction to sliding friction
-    GetCharacterMovement()->GroundFriction = SlideFriction;
-    GetCharacterMovement()->BrakingFrictionFactor = 0.1f;
-    // Sets walkspeed to bIsCrouching walkspeed
-    GetCharacterMovement()->MaxWalkSpeed = CrouchSpeed;
+        // Sets ground friction to sliding friction
+        GetCharacterMovement()->GroundFriction = SlideFriction;
+        GetCharacterMovement()->BrakingFrictionFactor = 0.1f;
+        // Sets walkspeed to bIsCrouching walkspeed
+        GetCharacterMovement()->MaxWalkSpeed = CrouchSpeed;
 
-    // Checks if character is on ground
-    if (GetCharacterMovement()->IsMovingOnGround())
-    {
-        StartSlide();
+        // Checks if character is on ground
+        if (GetCharacterMovement()->IsMovingOnGround())
+        {
+            StartSlide();
+        }
+        return;
     }
-}
-// Stops Crouching
-void AFPSCharacter::StopCrouch(const FInputActionInstance &Instance)
-{
+
     // SetActorScale3D(NormalScale);
     // FVector NewLocation = GetActorLocation();
     // NewLocation.Z += NormalScale.Z - CrouchScale.Z;
@@ -290,9 +501,21 @@ bool AFPSCharacter::GradualSlide(const float &DeltaTime)
         return false;
     }
 }
+// Applies force to speed up player when sliding down slopes
+void AFPSCharacter::SlopeSlide(const float &DeltaTime)
+{
+    // Projected vector on slope
+    FVector ProjectedVector =
+        FVector::VectorPlaneProject(FVector::DownVector, GetCharacterMovement()->CurrentFloor.HitResult.Normal);
+    // Adds downwards force based off player's allignment off slope
+    GetCharacterMovement()->Velocity +=
+        FMath::Abs(FVector::DotProduct(GetActorForwardVector(), ProjectedVector.GetSafeNormal2D())) * ProjectedVector *
+        DeltaTime * 10000.f;
+}
 // Applies initial slide force and starts gradual slide
 void AFPSCharacter::StartSlide()
 {
+    TRACE_CPUPROFILER_EVENT_SCOPE(AFPSCharacter::StartSlide);
     // Checks if player has enough speed to apply slide force
     if (GetCharacterMovement()->Velocity.SizeSquared2D() > MinSlideSpeed * MinSlideSpeed && !bAppliedSlideForce)
     {
@@ -300,6 +523,7 @@ void AFPSCharacter::StartSlide()
         GetCharacterMovement()->Velocity += GetCharacterMovement()->Velocity.GetSafeNormal2D() * SlideForce;
         bAppliedSlideForce = true;
         AddVelocityMag = GradualSlideForce;
+        CountClientMovementEvent(EFPSMetric::SlideStart);
 
         // GEngine->AddOnScreenDebugMessage(0, 5.0f, FColor::Cyan, TEXT("JumpSlide"));
     }
@@ -309,12 +533,19 @@ void AFPSCharacter::OnComponentHitCharacter(UPrimitiveComponent *HitComp, AActor
                                             UPrimitiveComponent *OtherComp, FVector NormalImpulse,
                                             const FHitResult &Hit)
 {
+    // Hits arrive from the movement component tick, outside of Tick, every frame of a wall run
+    LLM_SCOPE_BYTAG(FPSMovement);
+    FScopedAllocationTally Allocations(FrameAllocations, CVarMovementAllocCheck.GetValueOnGameThread());
     WallLineTraceDelegate.Broadcast(Hit);
     // GEngine->AddOnScreenDebugMessage(0, 5.0f, FColor::Cyan, TEXT("CompHit"));
 }
 // Makes smoothly camera tilt when sliding
 void AFPSCharacter::SmoothCameraTilt(const float &Angle, const float &TiltSpeed, const float &DeltaTime)
 {
+    if (!bCosmeticsEnabled)
+    {
+        return;
+    }
     FRotator CameraTilt = CameraComp->GetRelativeRotation();
     if (!FMath::IsNearlyEqual(CameraTilt.Roll, Angle))
     {
@@ -332,6 +563,7 @@ bool AFPSCharacter::IsWall(const FVector &Normal)
 // Starts the wall run
 void AFPSCharacter::StartWallRun(const FHitResult &Hit)
 {
+    TRACE_CPUPROFILER_EVENT_SCOPE(AFPSCharacter::StartWallRun);
     if (GetCharacterMovement()->IsFalling())
     {
         if (!bIsWallrunning)
@@ -343,6 +575,7 @@ void AFPSCharacter::StartWallRun(const FHitResult &Hit)
             AirJumpCount = AirJumpMax;
             // Set gravity to normal
             GetCharacterMovement()->GravityScale = 1;
+            UFPSMetricsSubsystem::Increment(this, EFPSMetric::WallRunStart);
         }
         WallNormalVector = Hit.Normal;
         WallRunTiltDirection = FMath::Sign(FVector::DotProduct(GetActorRightVector(), WallNormalVector));
@@ -350,9 +583,12 @@ void AFPSCharacter::StartWallRun(const FHitResult &Hit)
         WallPerpendicularNormalVector *=
             FMath::Sign(FVector::DotProduct(GetCharacterMovement()->Velocity, WallPerpendicularNormalVector));
         GetCharacterMovement()->AirControl = WallRunAirControl;
-        GEngine->AddOnScreenDebugMessage(
-            INDEX_NONE, 5.0f, FColor::Blue,
-            FString::Printf(TEXT("Perpenticulat wall vector = %s"), *WallPerpendicularNormalVector.ToString()));
+        if (ShowDebugMessages())
+        {
+            GEngine->AddOnScreenDebugMessage(
+                INDEX_NONE, 5.0f, FColor::Blue,
+                FString::Printf(TEXT("Perpenticulat wall vector = %s"), *WallPerpendicularNormalVector.ToString()));
+        }
     }
 }
 // Called every frame when wall running
@@ -377,27 +613,28 @@ void AFPSCharacter::StopWallRun()
     {
         GetCharacterMovement()->GravityScale = 1.5;
         GetCharacterMovement()->AirControl = .1;
-        if (AirControlResetTimer.IsValid())
-        {
-            GetWorldTimerManager().ClearTimer(AirControlResetTimer);
-        }
-        GetWorldTimerManager().SetTimer(
-            AirControlResetTimer, [this]() { GetCharacterMovement()->AirControl = 0.7; }, .4, false);
+        // Air control goes back to normal in Tick
+        AirControlResetTime = GetWorld()->GetTimeSeconds() + .4;
     }
 }
 // Jumps off the wall when wall running
 void AFPSCharacter::WallJump()
 {
+    LLM_SCOPE_BYTAG(FPSMovement);
+    FScopedAllocationTally Allocations(FrameAllocations, CVarMovementAllocCheck.GetValueOnGameThread());
     // TODO #8 - Make wall jump intensity consistent regardless of player's orientation to wall
     // Check if character is on wall and wall running
     if (bIsWallrunning)
     {
         StopWallRun();
         // Debug Message
-        GEngine->AddOnScreenDebugMessage(
-            INDEX_NONE, 2, FColor::Red,
-            FString::Printf(TEXT("Wall Normal: %s"),
-                            *FVector::VectorPlaneProject(WallNormalVector, FVector::UpVector).ToString()));
+        if (ShowDebugMessages())
+        {
+            GEngine->AddOnScreenDebugMessage(
+                INDEX_NONE, 2, FColor::Red,
+                FString::Printf(TEXT("Wall Normal: %s"),
+                                *FVector::VectorPlaneProject(WallNormalVector, FVector::UpVector).ToString()));
+        }
         // TODO #6 - Make wall jump preserve xy velocity
         // Launches the player upwards and off the wall
         LaunchCharacter((FVector::UpVector * 1 + FVector::VectorPlaneProject(WallNormalVector, FVector::UpVector) * 2) *
@@ -405,6 +642,13 @@ void AFPSCharacter::WallJump()
                         false, true);
     }
 }
+// Called when jump is pressed, by the player's input binding and by bots
+void AFPSCharacter::ApplyJumpInput()
+{
+    Jump();
+    WallJump();
+    AirJump();
+}
 // Triggers on landing from jump
 void AFPSCharacter::OnJumpLand(const FHitResult &Hit)
 {
@@ -430,14 +674,24 @@ void AFPSCharacter::OnJumpLand(const FHitResult &Hit)
 // TODO #3 - Add double jumping
 void AFPSCharacter::AirJump()
 {
+    TRACE_CPUPROFILER_EVENT_SCOPE(AFPSCharacter::AirJump);
+    LLM_SCOPE_BYTAG(FPSMovement);
+    FScopedAllocationTally Allocations(FrameAllocations, CVarMovementAllocCheck.GetValueOnGameThread());
     // Increases gravity when jumping
     GetCharacterMovement()->GravityScale = 1.5;
     if (GetCharacterMovement()->IsFalling() && !bIsWallrunning && AirJumpCount > 0)
     {
-        // Spawns particle effect
-        FVector Location = GetActorLocation();
-        Location.Z -= 55;
-        UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplosionParticle, Location);
+        // Spawns particle effect, pooled so repeated air jumps reuse components
+        if (bCosmeticsEnabled)
+        {
+            LLM_SCOPE_BYTAG(FPSEffects);
+            FVector Location = GetActorLocation();
+            Location.Z -= 55;
+            UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplosionParticle, Location, FRotator::ZeroRotator,
+                                                     FVector(1.f), true, EPSCPoolMethod::AutoRelease);
+        }
+        // Counted even where the effect isn't spawned, as metrics run on dedicated servers
+        CountClientMovementEvent(EFPSMetric::EffectSpawn);
         // Adds jump force
         LaunchCharacter(GetActorUpVector() * GetCharacterMovement()->JumpZVelocity, false, true);
         AirJumpCount--;
@@ -448,16 +702,16 @@ void AFPSCharacter::OnLineWallTraceHit(const FHitResult &Hit)
 {
     if (Hit.GetComponent() && CurrentWall && Hit.GetComponent() == CurrentWall)
     {
-        if (WallRunTimer.IsValid())
-        {
-            GetWorldTimerManager().ClearTimer(WallRunTimer);
-        }
-        GetWorldTimerManager().SetTimer(WallRunTimer, [this]() { StopWallRun(); }, .1, false);
+        // Wall run stops in Tick once the wall hasn't been hit for a while
+        WallRunTimeout = GetWorld()->GetTimeSeconds() + .1;
     }
     if (IsWall(Hit.Normal))
     {
-        GEngine->AddOnScreenDebugMessage(INDEX_NONE, 2, FColor::Red,
-                                         FString::Printf(TEXT("IsWall! Hit.Normal = %s"), *Hit.Normal.ToString()));
+        if (ShowDebugMessages())
+        {
+            GEngine->AddOnScreenDebugMessage(
+                INDEX_NONE, 2, FColor::Red, FString::Printf(TEXT("IsWall! Hit.Normal = %s"), *Hit.Normal.ToString()));
+        }
         StartWallRun(Hit);
     }
 }
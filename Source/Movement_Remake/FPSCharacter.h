@@ -7,7 +7,6 @@
 #include "Components/StaticMeshComponent.h"
 #include "Camera/CameraComponent.h"
 #include "Engine/EngineTypes.h"
-#include "Engine/TimerHandle.h"
 #include "GameFramework/Actor.h"
 #include "GameFramework/Character.h"
 #include "GameFramework/SpringArmComponent.h"
@@ -20,6 +19,8 @@
 //////////////////
 //////////////////////
 
+enum class EFPSMetric : uint8;
+
 UDELEGATE()
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWallLineTrace, const FHitResult &, Hit);
 
@@ -28,9 +29,16 @@ class MOVEMENT_REMAKE_API AFPSCharacter : public ACharacter
 {
     GENERATED_BODY()
 
+    // Movement math microbenchmarks call the private movement functions directly
+    friend class FMovementBenchmark;
+    // Allocation tests drive the input handlers and check the movement state they reach
+    friend class FMovementAllocationTest;
+    // Parkour nav link reach and costs are derived from the movement settings
+    friend struct FParkourMoveLimits;
+
 public:
     // Sets default values for this character's properties
-    AFPSCharacter();
+    AFPSCharacter(const FObjectInitializer &ObjectInitializer);
 
 protected:
     // Called when the game starts or when spawned
@@ -42,6 +50,31 @@ public:
 
     // Called to bind functionality to input
     virtual void SetupPlayerInputComponent(class UInputComponent *PlayerInputComponent) override;
+    // Called on the owning client when the character is possessed, including reuse from the character pool
+    virtual void PawnClientRestart() override;
+
+    // Resets crouch, slide, wall run, air jump, timeout and scale state to that of a freshly spawned character
+    void ResetMovementState();
+    // Hides the character and turns off its collision, ticking and movement while it waits in a character pool
+    void SetPooled(bool bInPooled);
+    bool IsPooled() const
+    {
+        return bPooled;
+    }
+
+    // Movement intents behind the player's input bindings, also used by bots so both move the same way
+    // Moves the character from a walk input where X is right and Y is forward
+    void ApplyWalkInput(const FVector &Input);
+    // Jumps, wall jumps or air jumps depending on the movement state
+    void ApplyJumpInput();
+    // Crouches, sliding when on the ground, while pressed
+    void ApplyCrouchInput(bool bPressed);
+    bool IsWallRunning() const
+    {
+        return bIsWallrunning;
+    }
+    // One line summary of the movement state, for hitch reports
+    FString DescribeMovementState() const;
 
 private:
     // Base character components
@@ -151,10 +184,20 @@ private:
     float MinSlideSpeed = WalkSpeed * .5;
     // Keeps track of current player wasd input
     FVector WalkingInput = {0, 0, 0};
-    // Keeps track of air control reset time after wall jump
-    FTimerHandle AirControlResetTimer;
-    // Timer to keep track whether player is still wall running
-    FTimerHandle WallRunTimer;
+    // World time air control is reset at after a wall jump, 0 when not pending
+    double AirControlResetTime = 0;
+    // World time the wall run stops at unless the wall is hit again, 0 when not pending
+    double WallRunTimeout = 0;
+    // False on dedicated servers, where cosmetic work is skipped
+    bool bCosmeticsEnabled = true;
+    // True while the character waits unused in the game mode's character pool
+    bool bPooled = false;
+    // Heap allocations made this frame by Tick and the input handlers, counted when fps.Movement.AllocCheck is on
+    int64 FrameAllocations = 0;
+    // Heap allocations made in steady slide, wall run or air frames, checked by the allocation tests
+    int64 SteadyFrameAllocations = 0;
+    // Movement state at the end of the last tick, used to tell steady frames from transitions
+    uint32 LastMovementState = 0;
 
 protected:
     // Wall detection script delegate
@@ -177,6 +220,8 @@ private:
     UFUNCTION()
     bool GradualSlide(const float &DeltaTime);
     UFUNCTION()
+    void SlopeSlide(const float &DeltaTime);
+    UFUNCTION()
     void OnComponentHitCharacter(UPrimitiveComponent *HitComp, AActor *OtherActor, UPrimitiveComponent *OtherComp,
                                  FVector NormalImpulse, const FHitResult &Hit);
     UFUNCTION()
@@ -201,6 +246,17 @@ private:
     void AirAccelerate(FVector WishVelocity);
     UFUNCTION()
     void OnLineWallTraceHit(const FHitResult &Hit);
+    // Whether camera, particle and debug text work should run for this character
+    bool ShouldRunCosmetics() const;
+    bool ShowDebugMessages() const;
+    // Applies bPooled to visibility, collision, ticking and movement
+    void ApplyPooledState();
+    // Counts a slide or air jump in the metrics. Players only slide and air jump on their own client, so the owning
+    // client also sends the event to the server, where metrics run by default.
+    void CountClientMovementEvent(EFPSMetric Metric);
+    UFUNCTION(Server, Unreliable)
+    void ServerCountMovementEvent(uint8 Metric);
+    void CheckFrameAllocations();
     UFUNCTION()
     FVector VectorRotate(const FVector &vec, const double &theta, const double &phi, const double &rho);
 };
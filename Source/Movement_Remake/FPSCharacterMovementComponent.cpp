@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FPSCharacterMovementComponent.h"
+#include "FPSMetricsSubsystem.h"
+
+bool UFPSCharacterMovementComponent::ServerCheckClientError(float ClientTimeStamp, float DeltaTime,
+                                                            const FVector &Accel, const FVector &ClientLoc,
+                                                            const FVector &RelativeClientLoc,
+                                                            UPrimitiveComponent *ClientMovementBase,
+                                                            FName ClientBaseBoneName, uint8 ClientMovementMode)
+{
+    const bool bHasError = Super::ServerCheckClientError(ClientTimeStamp, DeltaTime, Accel, ClientLoc,
+                                                         RelativeClientLoc, ClientMovementBase, ClientBaseBoneName,
+                                                         ClientMovementMode);
+    if (bHasError)
+    {
+        UFPSMetricsSubsystem::Increment(this, EFPSMetric::MovementCorrection);
+    }
+    return bHasError;
+}
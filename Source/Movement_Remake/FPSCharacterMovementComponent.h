@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "FPSCharacterMovementComponent.generated.h"
+
+/**
+ * Character movement used by AFPSCharacter, reports server side corrections to the metrics subsystem
+ */
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSCharacterMovementComponent : public UCharacterMovementComponent
+{
+    GENERATED_BODY()
+
+public:
+    // Counts moves where the server disagrees with the client and will send a correction
+    virtual bool ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector &Accel,
+                                        const FVector &ClientLoc, const FVector &RelativeClientLoc,
+                                        UPrimitiveComponent *ClientMovementBase, FName ClientBaseBoneName,
+                                        uint8 ClientMovementMode) override;
+};
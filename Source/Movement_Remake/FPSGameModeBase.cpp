@@ -1,5 +1,436 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
-
 #include "FPSGameModeBase.h"
+#include "FPSCharacter.h"
+#include "FPSStartupTimingSubsystem.h"
+#include "GunBase.h"
+#include "Movement_Remake.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+static TAutoConsoleVariable<bool> CVarCharacterPoolEnabled(
+    TEXT("fps.CharacterPool.Enabled"), true,
+    TEXT("Respawns players with pooled characters instead of spawning new ones, read when a character is needed"));
+
+AFPSGameModeBase::AFPSGameModeBase()
+{
+    RoundActorClasses = {AFPSCharacter::StaticClass(), AGunBase::StaticClass()};
+}
+
+void AFPSGameModeBase::PostInitializeComponents()
+{
+    Super::PostInitializeComponents();
+    FillCharacterPool();
+}
+
+void AFPSGameModeBase::StartPlay()
+{
+    Super::StartPlay();
+    SnapshotRound();
+    ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(
+        FOnActorSpawned::FDelegate::CreateUObject(this, &AFPSGameModeBase::OnActorSpawned));
+    // Streamed actors don't go through OnActorSpawned, so their levels are snapshotted as they load
+    LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &AFPSGameModeBase::OnLevelAddedToWorld);
+    LevelRemovedHandle =
+        FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &AFPSGameModeBase::OnLevelRemovedFromWorld);
+}
+
+void AFPSGameModeBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+    FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+    FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+    Super::EndPlay(EndPlayReason);
+}
+
+void AFPSGameModeBase::FillCharacterPool()
+{
+    if (!CVarCharacterPoolEnabled.GetValueOnGameThread() || !DefaultPawnClass ||
+        !DefaultPawnClass->IsChildOf<AFPSCharacter>())
+    {
+        return;
+    }
+    FActorSpawnParameters SpawnParams;
+    SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+    SpawnParams.ObjectFlags |= RF_Transient;
+    while (CharacterPool.Num() < CharacterPoolSize)
+    {
+        AFPSCharacter *Character =
+            GetWorld()->SpawnActor<AFPSCharacter>(DefaultPawnClass, GetActorTransform(), SpawnParams);
+        if (!Character)
+        {
+            break;
+        }
+        Character->SetPooled(true);
+        CharacterPool.Add(Character);
+    }
+}
+
+void AFPSGameModeBase::RestartPlayer(AController *NewPlayer)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(AFPSGameModeBase::RestartPlayer);
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    Super::RestartPlayer(NewPlayer);
+    UE_LOG(LogMovementRemake, Log, TEXT("Restarted %s in %.3f ms, %d characters left in pool"), *GetNameSafe(NewPlayer),
+           FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles), CharacterPool.Num());
+}
+
+// Takes a character of the right class out of the pool, falls back to spawning one when the pool has none
+APawn *AFPSGameModeBase::SpawnDefaultPawnAtTransform_Implementation(AController *NewPlayer,
+                                                                    const FTransform &SpawnTransform)
+{
+    const UClass *PawnClass = GetDefaultPawnClassForController(NewPlayer);
+    const int32 Index = CVarCharacterPoolEnabled.GetValueOnGameThread()
+                            ? CharacterPool.IndexOfByPredicate([PawnClass](const AFPSCharacter *Character) {
+                                  return IsValid(Character) && Character->GetClass() == PawnClass;
+                              })
+                            : INDEX_NONE;
+    if (Index == INDEX_NONE)
+    {
+        return Super::SpawnDefaultPawnAtTransform_Implementation(NewPlayer, SpawnTransform);
+    }
+
+    AFPSCharacter *Character = CharacterPool[Index];
+    CharacterPool.RemoveAtSwap(Index);
+    Character->SetActorLocationAndRotation(SpawnTransform.GetLocation(), SpawnTransform.GetRotation(), false, nullptr,
+                                           ETeleportType::ResetPhysics);
+    Character->ResetMovementState();
+    Character->SetPooled(false);
+    return Character;
+}
+
+void AFPSGameModeBase::RespawnPlayer(AController *Player)
+{
+    if (!Player)
+    {
+        return;
+    }
+    if (AFPSCharacter *Character = Cast<AFPSCharacter>(Player->GetPawn()))
+    {
+        ReleaseCharacter(Character);
+    }
+    else if (APawn *Pawn = Player->GetPawn())
+    {
+        Player->UnPossess();
+        Pawn->Destroy();
+    }
+    RestartPlayer(Player);
+}
+
+void AFPSGameModeBase::RespawnPlayers()
+{
+    for (FConstControllerIterator It = GetWorld()->GetControllerIterator(); It; ++It)
+    {
+        if (CanRespawn(It->Get()))
+        {
+            RespawnPlayer(It->Get());
+        }
+    }
+}
+
+// Players and bots, but not spectators, who keep spectating rather than getting a pawn from the pool
+bool AFPSGameModeBase::CanRespawn(AController *Controller)
+{
+    if (!Controller || !Controller->PlayerState || Controller->PlayerState->IsOnlyASpectator())
+    {
+        return false;
+    }
+    APlayerController *PlayerController = Cast<APlayerController>(Controller);
+    return !PlayerController || PlayerCanRestart(PlayerController);
+}
+
+// Each respawn is timed on its own, and the respawns of a round together, as that is the frame a round reset spikes.
+// Destroyed characters are garbage collected later, outside the timing, so numbers without the pool are a lower bound.
+void AFPSGameModeBase::CompareRespawns(int32 Rounds)
+{
+    TArray<AController *> Players;
+    for (FConstControllerIterator It = GetWorld()->GetControllerIterator(); It; ++It)
+    {
+        if (CanRespawn(It->Get()))
+        {
+            Players.Add(It->Get());
+        }
+    }
+    if (Players.Num() == 0)
+    {
+        UE_LOG(LogMovementRemake, Warning, TEXT("fps.Respawn.Compare needs at least one player or bot"));
+        return;
+    }
+
+    const bool bPoolWasEnabled = CVarCharacterPoolEnabled.GetValueOnGameThread();
+    for (const bool bPooled : {false, true})
+    {
+        CVarCharacterPoolEnabled->Set(bPooled, ECVF_SetByConsole);
+        FillCharacterPool();
+        uint64 TotalCycles = 0;
+        uint64 LongestCycles = 0;
+        uint64 LongestRoundCycles = 0;
+        for (int32 Round = 0; Round < Rounds; Round++)
+        {
+            uint64 RoundCycles = 0;
+            for (AController *Player : Players)
+            {
+                const uint64 StartCycles = FPlatformTime::Cycles64();
+                RespawnPlayer(Player);
+                const uint64 Cycles = FPlatformTime::Cycles64() - StartCycles;
+                RoundCycles += Cycles;
+                LongestCycles = FMath::Max(LongestCycles, Cycles);
+            }
+            TotalCycles += RoundCycles;
+            LongestRoundCycles = FMath::Max(LongestRoundCycles, RoundCycles);
+        }
+        UE_LOG(LogMovementRemake, Display,
+               TEXT("Respawns %s pool: %.3f ms average, %.3f ms longest, %.3f ms longest frame of %d respawns"),
+               bPooled ? TEXT("with") : TEXT("without"),
+               FPlatformTime::ToMilliseconds64(TotalCycles) / (Rounds * Players.Num()),
+               FPlatformTime::ToMilliseconds64(LongestCycles), FPlatformTime::ToMilliseconds64(LongestRoundCycles),
+               Players.Num());
+    }
+    CVarCharacterPoolEnabled->Set(bPoolWasEnabled, ECVF_SetByConsole);
+}
+
+void AFPSGameModeBase::ReleaseCharacter(AFPSCharacter *Character)
+{
+    if (!IsValid(Character) || Character->IsPooled())
+    {
+        return;
+    }
+    if (AController *Controller = Character->GetController())
+    {
+        Controller->UnPossess();
+    }
+    if (CVarCharacterPoolEnabled.GetValueOnGameThread())
+    {
+        Character->SetPooled(true);
+        CharacterPool.Add(Character);
+    }
+    else
+    {
+        Character->Destroy();
+    }
+}
+
+bool AFPSGameModeBase::IsRoundActor(const AActor *Actor) const
+{
+    // Pooled characters and those of players and bots are handled by respawning their controllers instead
+    if (const AFPSCharacter *Character = Cast<AFPSCharacter>(Actor))
+    {
+        if (Character->IsPooled() || (Character->GetController() && Character->GetController()->PlayerState))
+        {
+            return false;
+        }
+    }
+    return RoundActorClasses.ContainsByPredicate(
+        [Actor](const TSubclassOf<AActor> &Class) { return Class && Actor->IsA(Class); });
+}
+
+void AFPSGameModeBase::SnapshotRound()
+{
+    RoundSnapshot.Reset();
+    RoundSpawnedActors.Reset();
+    for (ULevel *Level : GetWorld()->GetLevels())
+    {
+        if (Level && Level->bIsVisible)
+        {
+            SnapshotLevel(Level);
+        }
+    }
+}
+
+void AFPSGameModeBase::SnapshotLevel(ULevel *Level)
+{
+    for (AActor *Actor : Level->Actors)
+    {
+        if (!IsValid(Actor) || !IsRoundActor(Actor))
+        {
+            continue;
+        }
+        FRoundActorSnapshot &Snapshot = RoundSnapshot.FindOrAdd(Actor->GetPathName());
+        Snapshot.Actor = Actor;
+        Snapshot.Level = Level;
+        // A level that loads again brings its actors back as saved, so the state first seen is kept
+        if (!Snapshot.Template)
+        {
+            Snapshot.Template =
+                NewObject<AActor>(this, Actor->GetClass(), NAME_None, RF_ArchetypeObject | RF_Transient);
+            UEngine::CopyPropertiesForUnrelatedObjects(Actor, Snapshot.Template);
+            Snapshot.Transform = Actor->GetActorTransform();
+            Snapshot.bHidden = Actor->IsHidden();
+            Snapshot.bCollisionEnabled = Actor->GetActorEnableCollision();
+        }
+    }
+}
+
+void AFPSGameModeBase::OnLevelAddedToWorld(ULevel *Level, UWorld *World)
+{
+    if (Level && World == GetWorld())
+    {
+        SnapshotLevel(Level);
+    }
+}
+
+// Actors of an unloaded level aren't respawned, the level restores them when it loads again
+void AFPSGameModeBase::OnLevelRemovedFromWorld(ULevel *Level, UWorld *World)
+{
+    if (!Level || World != GetWorld())
+    {
+        return;
+    }
+    for (TPair<FString, FRoundActorSnapshot> &Pair : RoundSnapshot)
+    {
+        if (Pair.Value.Level == Level)
+        {
+            Pair.Value.Actor.Reset();
+            Pair.Value.Level.Reset();
+        }
+    }
+}
+
+void AFPSGameModeBase::OnActorSpawned(AActor *Actor)
+{
+    // Characters spawned during the round go back to the pool when players are respawned
+    if (!Actor->IsA<AFPSCharacter>() && IsRoundActor(Actor))
+    {
+        RoundSpawnedActors.Add(Actor);
+    }
+}
+
+// Resets the round within one frame and without unloading streamed cells. fps.Round.Compare times it against a map
+// reload.
+void AFPSGameModeBase::ResetRound()
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(AFPSGameModeBase::ResetRound);
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+
+    for (const TWeakObjectPtr<AActor> &Actor : RoundSpawnedActors)
+    {
+        if (Actor.IsValid())
+        {
+            Actor->Destroy();
+        }
+    }
+    RoundSpawnedActors.Reset();
+
+    int32 Restored = 0;
+    for (TPair<FString, FRoundActorSnapshot> &Pair : RoundSnapshot)
+    {
+        FRoundActorSnapshot &Snapshot = Pair.Value;
+        ULevel *Level = Snapshot.Level.Get();
+        if (!Level || !Snapshot.Template)
+        {
+            continue;
+        }
+        AActor *Actor = Snapshot.Actor.Get();
+        if (!Actor)
+        {
+            // Destroyed by gameplay while its level was loaded, comes back as a copy of the actor at match start
+            FActorSpawnParameters SpawnParams;
+            SpawnParams.Template = Snapshot.Template;
+            SpawnParams.OverrideLevel = Level;
+            SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+            Actor = GetWorld()->SpawnActor(Snapshot.Template->GetClass(), &Snapshot.Transform, SpawnParams);
+            // Spawning it added it to RoundSpawnedActors
+            RoundSpawnedActors.Reset();
+            Snapshot.Actor = Actor;
+            if (!Actor)
+            {
+                continue;
+            }
+        }
+        Actor->SetActorTransform(Snapshot.Transform, false, nullptr, ETeleportType::ResetPhysics);
+        Actor->SetActorHiddenInGame(Snapshot.bHidden);
+        Actor->SetActorEnableCollision(Snapshot.bCollisionEnabled);
+        if (AFPSCharacter *Character = Cast<AFPSCharacter>(Actor))
+        {
+            Character->ResetMovementState();
+        }
+        else
+        {
+            Actor->Reset();
+        }
+        Restored++;
+    }
+
+    RespawnPlayers();
+
+    UE_LOG(LogMovementRemake, Log, TEXT("Round reset in %.3f ms, %d actors restored"),
+           FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles), Restored);
+}
+
+static FAutoConsoleCommandWithWorld RespawnCommand(
+    TEXT("fps.Respawn"),
+    TEXT("Respawns every player and bot through the game mode, logging how long each respawn took"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld *World) {
+        AFPSGameModeBase *GameMode = World ? World->GetAuthGameMode<AFPSGameModeBase>() : nullptr;
+        if (!GameMode)
+        {
+            UE_LOG(LogMovementRemake, Warning, TEXT("fps.Respawn needs to run on the server with AFPSGameModeBase"));
+            return;
+        }
+        GameMode->RespawnPlayers();
+    }));
+
+// Compares respawn time and the size of the frame spike with and without the character pool. Headless:
+// Movement_RemakeServer FPSTestMap -ExecCmds="fps.Bots.Add 16, fps.Respawn.Compare 50, quit"
+static FAutoConsoleCommandWithWorldAndArgs RespawnCompareCommand(
+    TEXT("fps.Respawn.Compare"),
+    TEXT("Times respawning every player and bot without and with the character pool. Usage: fps.Respawn.Compare "
+         "[Rounds]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString> &Args, UWorld *World) {
+        AFPSGameModeBase *GameMode = World ? World->GetAuthGameMode<AFPSGameModeBase>() : nullptr;
+        if (!GameMode)
+        {
+            UE_LOG(LogMovementRemake, Warning,
+                   TEXT("fps.Respawn.Compare needs to run on the server with AFPSGameModeBase"));
+            return;
+        }
+        GameMode->CompareRespawns(Args.Num() > 0 && Args[0].IsNumeric() ? FMath::Max(FCString::Atoi(*Args[0]), 1)
+                                                                          : 50);
+    }));
+
+static FAutoConsoleCommandWithWorld RoundResetCommand(
+    TEXT("fps.Round.Reset"), TEXT("Resets the round in place and logs how long it took"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld *World) {
+        if (AFPSGameModeBase *GameMode = World ? World->GetAuthGameMode<AFPSGameModeBase>() : nullptr)
+        {
+            GameMode->ResetRound();
+        }
+        else
+        {
+            UE_LOG(LogMovementRemake, Warning, TEXT("fps.Round.Reset needs to run on the server with AFPSGameModeBase"));
+        }
+    }));
 
+// Times round resets, then reloads the map with ServerTravel so both show up side by side in Startup.csv. Headless:
+// Movement_RemakeServer FPSTestMap -ExecCmds="fps.Round.Compare 10 quit"
+static FAutoConsoleCommandWithWorldAndArgs RoundCompareCommand(
+    TEXT("fps.Round.Compare"),
+    TEXT("Times round resets against a map reload. Usage: fps.Round.Compare [Resets] [quit]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString> &Args, UWorld *World) {
+        AFPSGameModeBase *GameMode = World ? World->GetAuthGameMode<AFPSGameModeBase>() : nullptr;
+        const UGameInstance *GameInstance = World ? World->GetGameInstance() : nullptr;
+        UFPSStartupTimingSubsystem *StartupTiming =
+            GameInstance ? GameInstance->GetSubsystem<UFPSStartupTimingSubsystem>() : nullptr;
+        if (!GameMode || !StartupTiming)
+        {
+            UE_LOG(LogMovementRemake, Warning, TEXT("fps.Round.Compare needs to run on the server with AFPSGameModeBase"));
+            return;
+        }
+        const int32 Resets = Args.Num() > 0 && Args[0].IsNumeric() ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10;
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+        for (int32 i = 0; i < Resets; i++)
+        {
+            GameMode->ResetRound();
+        }
+        const double ResetSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles) / Resets;
+        StartupTiming->CompareWithMapReload(TEXT("RoundReset"), ResetSeconds, Args.Contains(TEXT("quit")));
+        World->ServerTravel(TEXT("?restart"));
+    }));
@@ -6,12 +6,94 @@
 #include "GameFramework/GameModeBase.h"
 #include "FPSGameModeBase.generated.h"
 
+class AFPSCharacter;
+class ULevel;
+
+// State of a round actor when its level was first loaded during the match
+USTRUCT()
+struct FRoundActorSnapshot
+{
+	GENERATED_BODY()
+
+	// The actor while its level is loaded
+	TWeakObjectPtr<AActor> Actor;
+	// Level the actor is loaded in, null while the level is unloaded
+	TWeakObjectPtr<ULevel> Level;
+	// Copy of the actor as it was, spawned from when gameplay destroyed the actor so placed properties come back too
+	UPROPERTY()
+	AActor *Template = nullptr;
+	FTransform Transform;
+	bool bHidden = false;
+	bool bCollisionEnabled = true;
+};
+
 /**
- * 
+ * Game mode that keeps a pool of pre-spawned characters so respawns repossess a reset character instead of spawning one,
+ * and that can reset a round in place without reloading the map
  */
 UCLASS()
 class MOVEMENT_REMAKE_API AFPSGameModeBase : public AGameModeBase
 {
 	GENERATED_BODY()
-	
+
+public:
+	AFPSGameModeBase();
+
+	virtual void PostInitializeComponents() override;
+	virtual void StartPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void RestartPlayer(AController *NewPlayer) override;
+	virtual APawn *SpawnDefaultPawnAtTransform_Implementation(AController *NewPlayer,
+															  const FTransform &SpawnTransform) override;
+
+	// Returns a player's character to the pool and restarts the player with a pooled one
+	UFUNCTION(BlueprintCallable, Category = "Character Pool")
+	void RespawnPlayer(AController *Player);
+	// Respawns every player and bot, that is every controller with a player state, skipping spectators
+	UFUNCTION(BlueprintCallable, Category = "Character Pool")
+	void RespawnPlayers();
+	// Respawns every player and bot Rounds times without the character pool, then with it, and logs how long the
+	// respawns took
+	void CompareRespawns(int32 Rounds);
+	// Unpossesses a character and puts it back in the pool, or destroys it when pooling is off
+	UFUNCTION(BlueprintCallable, Category = "Character Pool")
+	void ReleaseCharacter(AFPSCharacter *Character);
+
+	// Puts round actors back to their state at match start and respawns every player, without reloading the map
+	UFUNCTION(BlueprintCallable, Category = "Round")
+	void ResetRound();
+
+private:
+	// Spawns characters until the pool holds CharacterPoolSize of them
+	void FillCharacterPool();
+	// Whether a controller is a player or bot that respawns, rather than a spectator
+	bool CanRespawn(AController *Controller);
+	// Records the state of every round actor in the loaded levels
+	void SnapshotRound();
+	// Records round actors of a level seen for the first time, and rebinds ones whose level was loaded before
+	void SnapshotLevel(ULevel *Level);
+	void OnLevelAddedToWorld(ULevel *Level, UWorld *World);
+	void OnLevelRemovedFromWorld(ULevel *Level, UWorld *World);
+	void OnActorSpawned(AActor *Actor);
+	bool IsRoundActor(const AActor *Actor) const;
+
+	// Number of deactivated characters spawned up front
+	UPROPERTY(EditDefaultsOnly, Category = "Character Pool")
+	int32 CharacterPoolSize = 8;
+
+	// Deactivated characters ready to be possessed
+	UPROPERTY(Transient)
+	TArray<AFPSCharacter *> CharacterPool;
+
+	// Actors of these classes are restored on round reset, and ones spawned during the round are destroyed
+	UPROPERTY(EditDefaultsOnly, Category = "Round")
+	TArray<TSubclassOf<AActor>> RoundActorClasses;
+	// Round actors present at match start or in levels streamed in since, keyed by path so reloaded actors rebind
+	UPROPERTY(Transient)
+	TMap<FString, FRoundActorSnapshot> RoundSnapshot;
+	// Round actors spawned since match start
+	TArray<TWeakObjectPtr<AActor>> RoundSpawnedActors;
+	FDelegateHandle ActorSpawnedHandle;
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
 };
@@ -0,0 +1,335 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FPSHitchCaptureSubsystem.h"
+#include "FPSCharacter.h"
+#include "Movement_Remake.h"
+#include "Containers/Ticker.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "ProfilingDebugging/MiscTrace.h"
+#include "ProfilingDebugging/TraceAuxiliary.h"
+#include "Trace/Trace.h"
+
+static TAutoConsoleVariable<float> CVarHitchThresholdMs(
+    TEXT("fps.Hitch.ThresholdMs"), 0.f,
+    TEXT("Frames longer than this many ms are captured to Saved/Hitches, 0 turns hitch capture and its tracing off"));
+static TAutoConsoleVariable<float> CVarHitchCooldown(
+    TEXT("fps.Hitch.Cooldown"), 30.f, TEXT("Seconds after a capture before another hitch is captured"));
+
+TRACE_DECLARE_INT_COUNTER(FPSCharacters, TEXT("FPS/Movement/Characters"));
+TRACE_DECLARE_INT_COUNTER(FPSWallRunning, TEXT("FPS/Movement/WallRunning"));
+TRACE_DECLARE_INT_COUNTER(FPSSliding, TEXT("FPS/Movement/Sliding"));
+TRACE_DECLARE_INT_COUNTER(FPSFalling, TEXT("FPS/Movement/Falling"));
+
+// Number of recent frames kept for the report, a few seconds at usual frame rates
+static constexpr int32 FrameHistory = 512;
+// Trace channels a capture needs
+static const TCHAR *const HitchTraceChannels[] = {TEXT("Cpu"), TEXT("Frame"), TEXT("Counters"), TEXT("Bookmark")};
+
+void UFPSHitchCaptureSubsystem::Initialize(FSubsystemCollectionBase &Collection)
+{
+    Super::Initialize(Collection);
+
+    Frames.SetNum(FrameHistory);
+    TickStartHandle =
+        FWorldDelegates::OnWorldTickStart.AddUObject(this, &UFPSHitchCaptureSubsystem::OnWorldTickStart);
+}
+
+void UFPSHitchCaptureSubsystem::Deinitialize()
+{
+    FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+    SetTracing(false);
+
+    Super::Deinitialize();
+}
+
+void UFPSHitchCaptureSubsystem::CountMovement(const UObject *WorldContext, bool bWallRunning, bool bSliding,
+                                              bool bFalling)
+{
+    // Nothing is counted while hitch capture is off, checked before the subsystem lookup so that costs nothing either
+    if (CVarHitchThresholdMs.GetValueOnGameThread() <= 0.f)
+    {
+        return;
+    }
+    const UWorld *World = WorldContext ? WorldContext->GetWorld() : nullptr;
+    const UGameInstance *GameInstance = World ? World->GetGameInstance() : nullptr;
+    UFPSHitchCaptureSubsystem *Hitches =
+        GameInstance ? GameInstance->GetSubsystem<UFPSHitchCaptureSubsystem>() : nullptr;
+    // Counting starts with the first frame the subsystem has seen start since the threshold was set
+    if (Hitches && Hitches->FrameStartTime > 0)
+    {
+        Hitches->FrameCharacters++;
+        Hitches->FrameWallRunning += bWallRunning;
+        Hitches->FrameSliding += bSliding;
+        Hitches->FrameFalling += bFalling;
+    }
+}
+
+double UFPSHitchCaptureSubsystem::ConsumeAverageFrameCost()
+{
+    const double Average = CostFrames > 0 ? FPlatformTime::ToSeconds64(CostCycles) / CostFrames : 0;
+    CostCycles = 0;
+    CostFrames = 0;
+    return Average;
+}
+
+void UFPSHitchCaptureSubsystem::ResetCooldown()
+{
+    NextCaptureTime = 0;
+}
+
+// The time between two world tick starts covers the whole frame, including rendering and any engine work in between
+void UFPSHitchCaptureSubsystem::OnWorldTickStart(UWorld *World, ELevelTick TickType, float DeltaSeconds)
+{
+    if (World != GetWorld())
+    {
+        return;
+    }
+    const float ThresholdMs = CVarHitchThresholdMs.GetValueOnGameThread();
+    if (ThresholdMs <= 0.f)
+    {
+        SetTracing(false);
+        FrameStartTime = 0;
+        return;
+    }
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    const double Now = FPlatformTime::Seconds();
+
+    SetTracing(true);
+
+    bool bHitch = false;
+    if (FrameStartTime > 0)
+    {
+        FFrameSample &Sample = Frames[NextFrame];
+        Sample.FrameMs = (Now - FrameStartTime) * 1000;
+        Sample.Characters = FrameCharacters;
+        Sample.WallRunning = FrameWallRunning;
+        Sample.Sliding = FrameSliding;
+        Sample.Falling = FrameFalling;
+        NextFrame = (NextFrame + 1) % Frames.Num();
+        FrameCount++;
+
+        TRACE_COUNTER_SET(FPSCharacters, Sample.Characters);
+        TRACE_COUNTER_SET(FPSWallRunning, Sample.WallRunning);
+        TRACE_COUNTER_SET(FPSSliding, Sample.Sliding);
+        TRACE_COUNTER_SET(FPSFalling, Sample.Falling);
+        bHitch = Sample.FrameMs > ThresholdMs && Now >= NextCaptureTime;
+    }
+    FrameCharacters = FrameWallRunning = FrameSliding = FrameFalling = 0;
+    CostCycles += FPlatformTime::Cycles64() - StartCycles;
+    CostFrames++;
+
+    if (bHitch)
+    {
+        NextCaptureTime = Now + CVarHitchCooldown.GetValueOnGameThread();
+        Capture(Frames[(NextFrame + Frames.Num() - 1) % Frames.Num()]);
+    }
+    // Taken after the capture so writing it doesn't count as a hitch of its own
+    FrameStartTime = FPlatformTime::Seconds();
+}
+
+// Without a trace file or host the channels only fill the tail buffer snapshots are written from. Channels that were
+// already on, for example from -trace, are left on when capture stops.
+void UFPSHitchCaptureSubsystem::SetTracing(bool bEnable)
+{
+    if (bTracing == bEnable)
+    {
+        return;
+    }
+    bTracing = bEnable;
+#if UE_TRACE_ENABLED
+    for (int32 Index = 0; Index < UE_ARRAY_COUNT(HitchTraceChannels); Index++)
+    {
+        if (bEnable)
+        {
+            const UE::Trace::FChannel *Channel = UE::Trace::FindChannel(HitchTraceChannels[Index]);
+            if (Channel && !Channel->IsEnabled())
+            {
+                UE::Trace::ToggleChannel(HitchTraceChannels[Index], true);
+                ChannelsTurnedOn |= 1 << Index;
+            }
+        }
+        else if (ChannelsTurnedOn & 1 << Index)
+        {
+            UE::Trace::ToggleChannel(HitchTraceChannels[Index], false);
+        }
+    }
+    if (!bEnable)
+    {
+        ChannelsTurnedOn = 0;
+    }
+#endif
+}
+
+void UFPSHitchCaptureSubsystem::Capture(const FFrameSample &Hitch)
+{
+    TRACE_BOOKMARK(TEXT("Hitch %.1f ms"), Hitch.FrameMs);
+
+    const FString Directory = FPaths::ProjectSavedDir() / TEXT("Hitches");
+    const FString BasePath =
+        Directory / FString::Printf(TEXT("Hitch_%s_%d_%dms"), *FDateTime::Now().ToString(TEXT("%Y%m%d_%H%M%S")),
+                                    CaptureCount, FMath::RoundToInt(Hitch.FrameMs));
+    IFileManager::Get().MakeDirectory(*Directory, true);
+
+    bool bTraceWritten = false;
+#if UE_TRACE_ENABLED
+    bTraceWritten = FTraceAuxiliary::WriteSnapshot(*(BasePath + TEXT(".utrace")));
+#endif
+    FFileHelper::SaveStringToFile(BuildReport(Hitch), *(BasePath + TEXT(".txt")),
+                                  FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM);
+    LastCapturePath = BasePath;
+    CaptureCount++;
+
+    UE_LOG(LogMovementRemake, Warning, TEXT("Captured a %.1f ms frame to %s.txt%s"), Hitch.FrameMs, *BasePath,
+           bTraceWritten ? TEXT(" and .utrace") : TEXT(", no trace snapshot was written"));
+}
+
+FString UFPSHitchCaptureSubsystem::BuildReport(const FFrameSample &Hitch) const
+{
+    const UWorld *World = GetWorld();
+    FString Report;
+    Report.Reserve(16 * 1024);
+    Report.Appendf(TEXT("Hitch: %.1f ms, threshold %.1f ms\n"), Hitch.FrameMs,
+                   CVarHitchThresholdMs.GetValueOnGameThread());
+    Report.Appendf(TEXT("Map: %s\nTime: %s\n\n"), World ? *World->GetMapName() : TEXT("none"),
+                   *FDateTime::Now().ToIso8601());
+
+    Report += TEXT("Frames, oldest first\nFrameMs,Characters,WallRunning,Sliding,Falling\n");
+    const int32 NumFrames = (int32)FMath::Min<uint64>(FrameCount, Frames.Num());
+    for (int32 Index = 0; Index < NumFrames; Index++)
+    {
+        const FFrameSample &Sample = Frames[(NextFrame - NumFrames + Index + Frames.Num()) % Frames.Num()];
+        Report.Appendf(TEXT("%.2f,%d,%d,%d,%d\n"), Sample.FrameMs, Sample.Characters, Sample.WallRunning,
+                       Sample.Sliding, Sample.Falling);
+    }
+
+    Report += TEXT("\nCharacters\n");
+    if (World)
+    {
+        for (TActorIterator<AFPSCharacter> It(World); It; ++It)
+        {
+            if (!It->IsPooled())
+            {
+                Report += It->DescribeMovementState();
+                Report += TEXT("\n");
+            }
+        }
+    }
+    return Report;
+}
+
+static FAutoConsoleCommandWithWorld HitchStatsCommand(
+    TEXT("fps.Hitch.Stats"), TEXT("Logs the per frame cost of the hitch detector since the last call"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld *World) {
+        UGameInstance *GameInstance = World ? World->GetGameInstance() : nullptr;
+        if (UFPSHitchCaptureSubsystem *Hitches =
+                GameInstance ? GameInstance->GetSubsystem<UFPSHitchCaptureSubsystem>() : nullptr)
+        {
+            UE_LOG(LogMovementRemake, Display, TEXT("Hitch detector: %.2f us per frame, %d captures"),
+                   Hitches->ConsumeAverageFrameCost() * 1e6, Hitches->GetCaptureCount());
+        }
+    }));
+
+// fps.Hitch.Test [Ms] [quit] stalls one frame for Ms and fails unless that frame was captured with both files. With
+// quit it exits with status 1 on failure, so it can run in CI:
+// UnrealEditor-Cmd <Project> -game -nullrhi -nosound -tracetailmb=32 -ExecCmds="fps.Hitch.Test 250 quit"
+static void TestHitchCapture(const TArray<FString> &Args, UWorld *World)
+{
+    const float HitchMs = Args.Num() > 0 && Args[0].IsNumeric() ? FCString::Atof(*Args[0]) : 250.f;
+    const bool bQuit = Args.Contains(TEXT("quit"));
+    UGameInstance *GameInstance = World ? World->GetGameInstance() : nullptr;
+    UFPSHitchCaptureSubsystem *Hitches =
+        GameInstance ? GameInstance->GetSubsystem<UFPSHitchCaptureSubsystem>() : nullptr;
+    if (!Hitches)
+    {
+        UE_LOG(LogMovementRemake, Error, TEXT("fps.Hitch.Test needs a game world"));
+        if (bQuit)
+        {
+            FPlatformMisc::RequestExitWithStatus(false, 1);
+        }
+        return;
+    }
+
+    // The threshold is put back once the test is over
+    const float ThresholdMs = CVarHitchThresholdMs.GetValueOnGameThread();
+    if (ThresholdMs <= 0.f || ThresholdMs > HitchMs * .5f)
+    {
+        CVarHitchThresholdMs->Set(HitchMs * .5f, ECVF_SetByConsole);
+    }
+    Hitches->ResetCooldown();
+
+    // Frame 1 lets the detector see a frame start after the threshold was set, frame 2 stalls, and the stalled frame
+    // is measured at the start of the next world tick
+    const TWeakObjectPtr<UFPSHitchCaptureSubsystem> WeakHitches = Hitches;
+    const int32 CapturesBefore = Hitches->GetCaptureCount();
+    int32 Frame = 0;
+    FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([=](float) mutable {
+        Frame++;
+        if (Frame == 2)
+        {
+            FPlatformProcess::Sleep(HitchMs / 1000.f);
+        }
+        UFPSHitchCaptureSubsystem *Subsystem = WeakHitches.Get();
+        const bool bCaptured = Subsystem && Subsystem->GetCaptureCount() > CapturesBefore;
+        if (!bCaptured && Frame < 10)
+        {
+            return true;
+        }
+
+        CVarHitchThresholdMs->Set(ThresholdMs, ECVF_SetByConsole);
+
+        TArray<FString> Failures;
+        FString Report;
+        if (!bCaptured)
+        {
+            Failures.Add(TEXT("the stalled frame was not captured"));
+        }
+        else
+        {
+            const FString &BasePath = Subsystem->GetLastCapturePath();
+            float CapturedMs = 0;
+            if (!FFileHelper::LoadFileToString(Report, *(BasePath + TEXT(".txt"))) ||
+                !FParse::Value(*Report, TEXT("Hitch:"), CapturedMs) || CapturedMs < HitchMs * .9f)
+            {
+                Failures.Add(TEXT("the report is missing or doesn't hold the stalled frame"));
+            }
+#if UE_TRACE_ENABLED
+            if (IFileManager::Get().FileSize(*(BasePath + TEXT(".utrace"))) <= 0)
+            {
+                Failures.Add(TEXT("no trace snapshot was written, check -tracetailmb"));
+            }
+#endif
+        }
+
+        if (Failures.Num() > 0)
+        {
+            UE_LOG(LogMovementRemake, Error, TEXT("fps.Hitch.Test failed: %s"),
+                   *FString::Join(Failures, TEXT(", ")));
+        }
+        else
+        {
+            UE_LOG(LogMovementRemake, Display, TEXT("fps.Hitch.Test passed, %.0f ms stall captured to %s"), HitchMs,
+                   *Subsystem->GetLastCapturePath());
+        }
+        if (bQuit)
+        {
+            FPlatformMisc::RequestExitWithStatus(false, Failures.Num() > 0 ? 1 : 0);
+        }
+        return false;
+    }));
+}
+
+static FAutoConsoleCommandWithWorldAndArgs HitchTestCommand(
+    TEXT("fps.Hitch.Test"),
+    TEXT("Stalls a frame and checks that it was captured. Usage: fps.Hitch.Test [Ms] [quit]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&TestHitchCapture));
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "FPSHitchCaptureSubsystem.generated.h"
+
+/**
+ * Writes a capture to Saved/Hitches when a frame takes longer than fps.Hitch.ThresholdMs. A capture is two files:
+ * - a .utrace snapshot of the trace tail buffer, holding the last few seconds of CPU scopes and movement counters, to
+ *   open in Unreal Insights. The tail size is set with -tracetailmb=<MB>.
+ * - a .txt report with recent frame times, movement counts and the movement state of every character.
+ * Tracing costs nothing until a threshold is set. While one is set, the CPU, frame, counter and bookmark trace channels
+ * are on. fps.Hitch.Stats logs what the detector itself costs per frame.
+ */
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSHitchCaptureSubsystem : public UGameInstanceSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase &Collection) override;
+    virtual void Deinitialize() override;
+
+    // Counts a character's movement for the current frame in the game instance the context object belongs to, called
+    // once per character tick on the game thread
+    static void CountMovement(const UObject *WorldContext, bool bWallRunning, bool bSliding, bool bFalling);
+
+    // Base path, without extension, of the last capture written, empty if there has been none
+    const FString &GetLastCapturePath() const
+    {
+        return LastCapturePath;
+    }
+    int32 GetCaptureCount() const
+    {
+        return CaptureCount;
+    }
+    // Lets the next hitch be captured even if the last capture was within fps.Hitch.Cooldown
+    void ResetCooldown();
+    // Average time the detector spent per frame since the last call, in seconds
+    double ConsumeAverageFrameCost();
+
+private:
+    // Frame time and how many characters were in each movement state during the frame
+    struct FFrameSample
+    {
+        float FrameMs = 0;
+        uint16 Characters = 0;
+        uint16 WallRunning = 0;
+        uint16 Sliding = 0;
+        uint16 Falling = 0;
+    };
+
+    void OnWorldTickStart(UWorld *World, ELevelTick TickType, float DeltaSeconds);
+    // Turns on the trace channels captures need, and back off the ones that weren't on before
+    void SetTracing(bool bEnable);
+    void Capture(const FFrameSample &Hitch);
+    FString BuildReport(const FFrameSample &Hitch) const;
+
+    // True while the trace channels captures need are on
+    bool bTracing = false;
+    // Bit per channel in HitchTraceChannels that SetTracing turned on
+    uint8 ChannelsTurnedOn = 0;
+    // Ring buffer of recent frames
+    TArray<FFrameSample> Frames;
+    int32 NextFrame = 0;
+    uint64 FrameCount = 0;
+    // Real time the current frame started at, 0 while hitch capture is off
+    double FrameStartTime = 0;
+    // Movement counts of the frame in progress, filled in by character ticks
+    uint16 FrameCharacters = 0;
+    uint16 FrameWallRunning = 0;
+    uint16 FrameSliding = 0;
+    uint16 FrameFalling = 0;
+    // No capture is written before this real time
+    double NextCaptureTime = 0;
+
+    FString LastCapturePath;
+    int32 CaptureCount = 0;
+
+    // Cycles spent in the detector and frames they were spent over
+    uint64 CostCycles = 0;
+    uint64 CostFrames = 0;
+
+    FDelegateHandle TickStartHandle;
+};
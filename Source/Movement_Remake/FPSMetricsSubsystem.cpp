@@ -0,0 +1,302 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FPSMetricsSubsystem.h"
+#include "Movement_Remake.h"
+#include "Engine/GameInstance.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformTime.h"
+#include "HttpModule.h"
+#include "HttpPath.h"
+#include "HttpServerModule.h"
+#include "HttpServerResponse.h"
+#include "IHttpRouter.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "UObject/UObjectIterator.h"
+
+static TAutoConsoleVariable<int32> CVarMetricsPort(TEXT("fps.Metrics.Port"), 9464,
+                                                   TEXT("Local HTTP port metrics are served on, 0 disables the endpoint"));
+static TAutoConsoleVariable<float> CVarMetricsFileInterval(
+    TEXT("fps.Metrics.FileInterval"), 0.f,
+    TEXT("Seconds between writes to Saved/Metrics/Metrics.prom, 0 disables the file"));
+static TAutoConsoleVariable<int32> CVarMetricsFileMaxKB(
+    TEXT("fps.Metrics.FileMaxKB"), 10240, TEXT("Size at which Metrics.prom is rolled over to Metrics.1.prom"));
+
+// Number of recent ticks tick time percentiles are computed over
+static constexpr int32 TickTimeWindow = 1024;
+
+void UFPSMetricsSubsystem::Initialize(FSubsystemCollectionBase &Collection)
+{
+    Super::Initialize(Collection);
+
+    if (!IsRunningDedicatedServer() && !FParse::Param(FCommandLine::Get(), TEXT("Metrics")))
+    {
+        return;
+    }
+    bEnabled = true;
+    TickTimes.SetNumZeroed(TickTimeWindow);
+
+    TickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &UFPSMetricsSubsystem::OnWorldTickStart);
+    EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UFPSMetricsSubsystem::OnEndFrame);
+
+    const int32 Port = CVarMetricsPort.GetValueOnGameThread();
+    if (Port > 0)
+    {
+        Router = FHttpServerModule::Get().GetHttpRouter(Port, /* bFailOnBindFailure = */ true);
+        if (Router.IsValid())
+        {
+            RouteHandle = Router->BindRoute(
+                FHttpPath(TEXT("/metrics")), EHttpServerRequestVerbs::VERB_GET,
+                FHttpRequestHandler::CreateUObject(this, &UFPSMetricsSubsystem::HandleMetricsRequest));
+            FHttpServerModule::Get().StartAllListeners();
+            UE_LOG(LogMovementRemake, Log, TEXT("Serving metrics on http://127.0.0.1:%d/metrics"), Port);
+        }
+        else
+        {
+            UE_LOG(LogMovementRemake, Warning, TEXT("Could not bind metrics endpoint to port %d"), Port);
+        }
+    }
+}
+
+void UFPSMetricsSubsystem::Deinitialize()
+{
+    if (Router.IsValid() && RouteHandle.IsValid())
+    {
+        Router->UnbindRoute(RouteHandle);
+    }
+    Router.Reset();
+    FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+    FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+    bEnabled = false;
+
+    Super::Deinitialize();
+}
+
+void UFPSMetricsSubsystem::Increment(const UObject *WorldContext, EFPSMetric Metric)
+{
+    const UWorld *World = WorldContext ? WorldContext->GetWorld() : nullptr;
+    const UGameInstance *GameInstance = World ? World->GetGameInstance() : nullptr;
+    if (UFPSMetricsSubsystem *Metrics = GameInstance ? GameInstance->GetSubsystem<UFPSMetricsSubsystem>() : nullptr)
+    {
+        if (Metrics->bEnabled)
+        {
+            Metrics->Counters[(int32)Metric]++;
+        }
+    }
+}
+
+void UFPSMetricsSubsystem::OnWorldTickStart(UWorld *World, ELevelTick TickType, float DeltaSeconds)
+{
+    if (World == GetWorld())
+    {
+        TickStartCycles = FPlatformTime::Cycles64();
+    }
+}
+
+// The tick is timed up to the end of the frame rather than the end of the actor tick, so it includes the net driver's
+// TickFlush where actors are replicated. The max tick rate wait happens before the world tick and is left out.
+void UFPSMetricsSubsystem::OnEndFrame()
+{
+    if (TickStartCycles == 0)
+    {
+        return;
+    }
+    const float TickSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - TickStartCycles);
+    TickTimes[NextTickTime] = TickSeconds;
+    NextTickTime = (NextTickTime + 1) % TickTimes.Num();
+    TickCount++;
+    TickSecondsSum += TickSeconds;
+    TickStartCycles = 0;
+
+    const float FileInterval = CVarMetricsFileInterval.GetValueOnGameThread();
+    if (FileInterval > 0.f)
+    {
+        const double Now = FPlatformTime::Seconds();
+        if (Now >= NextFileWriteTime)
+        {
+            NextFileWriteTime = Now + FileInterval;
+            WriteMetricsFile();
+        }
+    }
+}
+
+FString UFPSMetricsSubsystem::BuildPrometheusText() const
+{
+    FString Text;
+    Text.Reserve(2048);
+
+    // Tick time percentiles over the filled part of the ring buffer
+    TArray<float> SortedTickTimes(TickTimes.GetData(), (int32)FMath::Min<uint64>(TickCount, TickTimes.Num()));
+    SortedTickTimes.Sort();
+    auto Percentile = [&SortedTickTimes](double Quantile) {
+        return SortedTickTimes.Num() > 0
+                   ? SortedTickTimes[FMath::Min(FMath::FloorToInt32(Quantile * SortedTickTimes.Num()),
+                                                SortedTickTimes.Num() - 1)]
+                   : 0.f;
+    };
+    Text += TEXT("# HELP fps_server_tick_seconds World tick and replication time, quantiles of the last 1024 ticks\n");
+    Text += TEXT("# TYPE fps_server_tick_seconds summary\n");
+    for (const double Quantile : {.5, .9, .99, 1.})
+    {
+        Text.Appendf(TEXT("fps_server_tick_seconds{quantile=\"%g\"} %.6f\n"), Quantile, Percentile(Quantile));
+    }
+    Text.Appendf(TEXT("fps_server_tick_seconds_sum %.6f\n"), TickSecondsSum);
+    Text.Appendf(TEXT("fps_server_tick_seconds_count %llu\n"), TickCount);
+
+    const UWorld *World = GetWorld();
+    const AGameStateBase *GameState = World ? World->GetGameState() : nullptr;
+    Text += TEXT("# HELP fps_players Players in the match\n# TYPE fps_players gauge\n");
+    Text.Appendf(TEXT("fps_players %d\n"), GameState ? GameState->PlayerArray.Num() : 0);
+
+    auto AppendCounter = [this, &Text](const TCHAR *Name, const TCHAR *Help, EFPSMetric Metric) {
+        Text.Appendf(TEXT("# HELP %s %s\n# TYPE %s counter\n%s %llu\n"), Name, Help, Name, Name,
+                     Counters[(int32)Metric]);
+    };
+    AppendCounter(TEXT("fps_movement_corrections_total"), TEXT("Client moves corrected by the server"),
+                  EFPSMetric::MovementCorrection);
+    AppendCounter(TEXT("fps_wallrun_starts_total"), TEXT("Wall runs started"), EFPSMetric::WallRunStart);
+    AppendCounter(TEXT("fps_slide_starts_total"), TEXT("Slides started"), EFPSMetric::SlideStart);
+    AppendCounter(TEXT("fps_effects_spawned_total"),
+                  TEXT("Air jump particle effects, counted on the server too although only clients spawn them"),
+                  EFPSMetric::EffectSpawn);
+
+    // Effects are spawned into the world's particle component pool, which only fills where cosmetics run, so it stays
+    // empty on dedicated servers
+    int32 EffectsInUse = 0;
+    int32 EffectsFree = 0;
+    for (TObjectIterator<UParticleSystemComponent> It; It; ++It)
+    {
+        if (It->PoolingMethod != EPSCPoolMethod::None && !It->IsTemplate() && It->GetWorld() == World)
+        {
+            (It->IsActive() ? EffectsInUse : EffectsFree)++;
+        }
+    }
+    Text += TEXT("# HELP fps_effect_pool_components Particle components in the world's effect pool\n");
+    Text += TEXT("# TYPE fps_effect_pool_components gauge\n");
+    Text.Appendf(TEXT("fps_effect_pool_components{state=\"in_use\"} %d\n"), EffectsInUse);
+    Text.Appendf(TEXT("fps_effect_pool_components{state=\"free\"} %d\n"), EffectsFree);
+
+    // Samples of each metric family have to be contiguous, so connections are walked once per family
+    TArray<UNetConnection *, TInlineAllocator<16>> Connections;
+    if (const UNetDriver *NetDriver = World ? World->GetNetDriver() : nullptr)
+    {
+        Connections.Append(NetDriver->ClientConnections);
+        if (NetDriver->ServerConnection)
+        {
+            Connections.Add(NetDriver->ServerConnection);
+        }
+    }
+    Text += TEXT("# HELP fps_net_in_bytes_per_second Bytes received per second per connection\n");
+    Text += TEXT("# TYPE fps_net_in_bytes_per_second gauge\n");
+    for (UNetConnection *Connection : Connections)
+    {
+        Text.Appendf(TEXT("fps_net_in_bytes_per_second{connection=\"%s\"} %d\n"),
+                     *Connection->LowLevelGetRemoteAddress(true), Connection->InBytesPerSecond);
+    }
+    Text += TEXT("# HELP fps_net_out_bytes_per_second Bytes sent per second per connection\n");
+    Text += TEXT("# TYPE fps_net_out_bytes_per_second gauge\n");
+    for (UNetConnection *Connection : Connections)
+    {
+        Text.Appendf(TEXT("fps_net_out_bytes_per_second{connection=\"%s\"} %d\n"),
+                     *Connection->LowLevelGetRemoteAddress(true), Connection->OutBytesPerSecond);
+    }
+    return Text;
+}
+
+bool UFPSMetricsSubsystem::HandleMetricsRequest(const FHttpServerRequest &Request, const FHttpResultCallback &OnComplete)
+{
+    OnComplete(FHttpServerResponse::Create(BuildPrometheusText(), TEXT("text/plain; version=0.0.4")));
+    return true;
+}
+
+// Appends a timestamped snapshot to Saved/Metrics/Metrics.prom, rolling it over to Metrics.1.prom when it gets too big
+void UFPSMetricsSubsystem::WriteMetricsFile()
+{
+    const FString Directory = FPaths::ProjectSavedDir() / TEXT("Metrics");
+    const FString Path = Directory / TEXT("Metrics.prom");
+    const int64 FileSize = IFileManager::Get().FileSize(*Path);
+    if (FileSize > int64(CVarMetricsFileMaxKB.GetValueOnGameThread()) * 1024)
+    {
+        IFileManager::Get().Move(*(Directory / TEXT("Metrics.1.prom")), *Path, /* bReplace = */ true);
+    }
+    const FString Snapshot =
+        FString::Printf(TEXT("# timestamp %s\n"), *FDateTime::UtcNow().ToIso8601()) + BuildPrometheusText();
+    FFileHelper::SaveStringToFile(Snapshot, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM,
+                                  &IFileManager::Get(), FILEWRITE_Append);
+}
+
+static FAutoConsoleCommandWithWorld MetricsDumpCommand(
+    TEXT("fps.Metrics.Dump"), TEXT("Logs the current metrics in Prometheus text format"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld *World) {
+        const UGameInstance *GameInstance = World ? World->GetGameInstance() : nullptr;
+        if (const UFPSMetricsSubsystem *Metrics =
+                GameInstance ? GameInstance->GetSubsystem<UFPSMetricsSubsystem>() : nullptr)
+        {
+            UE_LOG(LogMovementRemake, Display, TEXT("\n%s"), *Metrics->BuildPrometheusText());
+        }
+    }));
+
+// Scrapes the local endpoint the way Prometheus would and checks the response holds every metric family, so the
+// endpoint can be checked headless:
+// Movement_RemakeServer FPSTestMap -ExecCmds="fps.Metrics.Check quit"
+static FAutoConsoleCommandWithArgs MetricsCheckCommand(
+    TEXT("fps.Metrics.Check"),
+    TEXT("Fetches /metrics from the local endpoint and checks it. Usage: fps.Metrics.Check [quit]"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString> &Args) {
+        const bool bQuit = Args.Contains(TEXT("quit"));
+        const FString Url =
+            FString::Printf(TEXT("http://127.0.0.1:%d/metrics"), CVarMetricsPort.GetValueOnGameThread());
+        const TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
+        Request->SetURL(Url);
+        Request->SetVerb(TEXT("GET"));
+        Request->OnProcessRequestComplete().BindLambda(
+            [Url, bQuit](FHttpRequestPtr, FHttpResponsePtr Response, bool bConnectedSuccessfully) {
+                bool bPassed = false;
+                if (!bConnectedSuccessfully || !Response.IsValid())
+                {
+                    UE_LOG(LogMovementRemake, Error, TEXT("Could not connect to %s"), *Url);
+                }
+                else if (Response->GetResponseCode() != 200)
+                {
+                    UE_LOG(LogMovementRemake, Error, TEXT("%s returned %d"), *Url, Response->GetResponseCode());
+                }
+                else
+                {
+                    const FString Text = Response->GetContentAsString();
+                    bPassed = true;
+                    for (const TCHAR *Family :
+                         {TEXT("fps_server_tick_seconds"), TEXT("fps_players"), TEXT("fps_movement_corrections_total"),
+                          TEXT("fps_wallrun_starts_total"), TEXT("fps_slide_starts_total"),
+                          TEXT("fps_effects_spawned_total"), TEXT("fps_effect_pool_components"),
+                          TEXT("fps_net_in_bytes_per_second"), TEXT("fps_net_out_bytes_per_second")})
+                    {
+                        if (!Text.Contains(FString::Printf(TEXT("# TYPE %s "), Family)))
+                        {
+                            UE_LOG(LogMovementRemake, Error, TEXT("%s is missing %s"), *Url, Family);
+                            bPassed = false;
+                        }
+                    }
+                    if (bPassed)
+                    {
+                        UE_LOG(LogMovementRemake, Display, TEXT("%s passed, %d bytes"), *Url, Text.Len());
+                    }
+                }
+                if (bQuit)
+                {
+                    FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+                }
+            });
+        Request->ProcessRequest();
+    }));
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "HttpResultCallback.h"
+#include "HttpRouteHandle.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "FPSMetricsSubsystem.generated.h"
+
+class IHttpRouter;
+struct FHttpServerRequest;
+
+// Event counters exported by UFPSMetricsSubsystem
+enum class EFPSMetric : uint8
+{
+    MovementCorrection,
+    WallRunStart,
+    SlideStart,
+    EffectSpawn,
+    Num
+};
+
+/**
+ * Collects match health metrics and serves them in Prometheus text format on http://127.0.0.1:<Port>/metrics.
+ * Runs on dedicated servers, or anywhere with -Metrics on the command line. Port and the optional rolling file are set
+ * with the fps.Metrics.* console variables.
+ */
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSMetricsSubsystem : public UGameInstanceSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase &Collection) override;
+    virtual void Deinitialize() override;
+
+    // Adds one to a counter of the game instance the context object belongs to, does nothing if metrics are off
+    static void Increment(const UObject *WorldContext, EFPSMetric Metric);
+
+    // Returns the current metrics in Prometheus text exposition format
+    FString BuildPrometheusText() const;
+
+private:
+    void OnWorldTickStart(UWorld *World, ELevelTick TickType, float DeltaSeconds);
+    void OnEndFrame();
+    bool HandleMetricsRequest(const FHttpServerRequest &Request, const FHttpResultCallback &OnComplete);
+    void WriteMetricsFile();
+
+    // True once collection has started
+    bool bEnabled = false;
+    // Event counters indexed by EFPSMetric
+    uint64 Counters[(int32)EFPSMetric::Num] = {};
+
+    // Ring buffer of the most recent world tick durations in seconds
+    TArray<float> TickTimes;
+    // Next slot to write in TickTimes
+    int32 NextTickTime = 0;
+    // Total ticks and tick seconds since collection started
+    uint64 TickCount = 0;
+    double TickSecondsSum = 0;
+    // Cycle counter at the start of the current world tick
+    uint64 TickStartCycles = 0;
+
+    // Time the rolling metrics file is next written
+    double NextFileWriteTime = 0;
+
+    TSharedPtr<IHttpRouter> Router;
+    FHttpRouteHandle RouteHandle;
+    FDelegateHandle TickStartHandle;
+    FDelegateHandle EndFrameHandle;
+};
@@ -0,0 +1,404 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FPSParkourNavLinks.h"
+#include "FPSCharacter.h"
+#include "Movement_Remake.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SceneComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Controller.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "NavigationData.h"
+#include "NavigationSystem.h"
+#include "NavigationSystemTypes.h"
+#include "PhysicsEngine/PhysicsSettings.h"
+
+FParkourMoveLimits FParkourMoveLimits::FromCharacter(const AFPSCharacter &Character, float GravityZ)
+{
+    const UCharacterMovementComponent *Movement = Character.GetCharacterMovement();
+    const float Gravity = FMath::Max(FMath::Abs(GravityZ), 1.f);
+    // AirJump raises gravity scale to 1.5 as soon as jump is pressed, StartWallRun puts it back to 1
+    const float JumpGravity = Gravity * 1.5f;
+    const float JumpVelocity = Movement->JumpZVelocity;
+
+    FParkourMoveLimits Limits;
+    Limits.WalkSpeed = Character.WalkSpeed;
+    Limits.CapsuleRadius = Character.GetCapsuleComponent()->GetUnscaledCapsuleRadius() * Character.NormalScale.X;
+    Limits.CapsuleHalfHeight = Character.GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight() * Character.NormalScale.Z;
+    Limits.WallChannel = Character.WallDetectionChannel;
+
+    // Every air jump is pressed at the apex of the one before and relaunches at jump velocity
+    Limits.AirJumps = FMath::Max(Character.AirJumpMax, 0);
+    const int32 Jumps = 1 + Limits.AirJumps;
+    Limits.AirJumpDelay = JumpVelocity / JumpGravity;
+    Limits.JumpHeight = Jumps * JumpVelocity * JumpVelocity / (2 * JumpGravity);
+    Limits.DoubleJumpTime = Jumps * Limits.AirJumpDelay + FMath::Sqrt(2 * Limits.JumpHeight / JumpGravity);
+    Limits.DoubleJumpDistance = Limits.WalkSpeed * Limits.DoubleJumpTime;
+
+    // StartWallRun sets vertical speed to 250 and WallRun counters part of gravity, the run is over once the character
+    // has sunk back to the height it started at. WallRun also pushes along the wall at a fifth of WallRunSpeed.
+    const float WallRunGravity = FMath::Max(Gravity - Movement->Mass * Character.WallRunCounterGravity * .4f, 1.f);
+    Limits.WallRunTime = 2 * 250 / WallRunGravity;
+    Limits.WallRunDistance =
+        Limits.WalkSpeed * Limits.WallRunTime + .1f * Character.WallRunSpeed * FMath::Square(Limits.WallRunTime);
+
+    // WallJump launches up at WallJumpForce and away from the wall at twice that
+    Limits.WallJumpTime = 2 * Character.WallJumpForce / JumpGravity;
+    Limits.WallJumpDistance = 2 * Character.WallJumpForce * Limits.WallJumpTime;
+    return Limits;
+}
+
+UFPSNavArea_DoubleJump::UFPSNavArea_DoubleJump()
+{
+    DrawColor = FColor(80, 200, 255);
+}
+
+UFPSNavArea_WallRun::UFPSNavArea_WallRun()
+{
+    DrawColor = FColor(255, 160, 40);
+}
+
+UFPSNavArea_WallJump::UFPSNavArea_WallJump()
+{
+    DrawColor = FColor(255, 60, 160);
+}
+
+UFPSParkourQueryFilter::UFPSParkourQueryFilter()
+{
+    // Costs depend on the querier's character, so each querier gets its own filter
+    bInstantiateForQuerier = true;
+}
+
+void UFPSParkourQueryFilter::InitializeFilter(const ANavigationData &NavData, const UObject *Querier,
+                                              FNavigationQueryFilter &Filter) const
+{
+    Super::InitializeFilter(NavData, Querier, Filter);
+
+    const AFPSCharacter *Character = Cast<AFPSCharacter>(Querier);
+    if (const AController *Controller = Cast<AController>(Querier))
+    {
+        Character = Cast<AFPSCharacter>(Controller->GetPawn());
+    }
+    if (!Character)
+    {
+        Character = GetDefault<AFPSCharacter>();
+    }
+    const UWorld *World = NavData.GetWorld();
+    const FParkourMoveLimits Limits = FParkourMoveLimits::FromCharacter(
+        *Character, World ? World->GetGravityZ() : UPhysicsSettings::Get()->DefaultGravityZ);
+
+    auto SetCost = [&NavData, &Filter](const UClass *AreaClass, float Cost) {
+        const int32 AreaId = NavData.GetAreaID(AreaClass);
+        if (AreaId >= 0)
+        {
+            // Costs below walking would make the pathfinding heuristic overestimate
+            Filter.SetAreaCost(uint8(AreaId), FMath::Max(Cost, 1.f));
+        }
+    };
+    SetCost(UFPSNavArea_DoubleJump::StaticClass(),
+            DoubleJumpPenalty * Limits.GetTimeCost(Limits.DoubleJumpDistance, Limits.DoubleJumpTime));
+    SetCost(UFPSNavArea_WallRun::StaticClass(),
+            WallRunPenalty * Limits.GetTimeCost(Limits.WallRunDistance, Limits.WallRunTime));
+    SetCost(UFPSNavArea_WallJump::StaticClass(),
+            WallJumpPenalty * Limits.GetTimeCost(Limits.WallJumpDistance, Limits.WallRunTime * .5f + Limits.WallJumpTime));
+}
+
+// Finds parkour moves from navmesh samples. Links are collected in world space.
+struct FParkourLinkGenerator
+{
+    const AActor *Owner;
+    UWorld *World;
+    UNavigationSystemV1 *NavSys;
+    ANavigationData *NavData;
+    FParkourMoveLimits Limits;
+    float SampleSpacing;
+    float DetourFactor;
+    float ReachMargin;
+    // Paths that walk only, so links from an earlier generation don't hide detours
+    FSharedNavQueryFilter WalkFilter;
+    FCollisionQueryParams TraceParams;
+
+    TArray<FNavigationLink> Links;
+    TArray<FVector> ViaPoints;
+
+    bool IsBlocked(const FVector &From, const FVector &To) const
+    {
+        return World->LineTraceTestByChannel(From, To, Limits.WallChannel, TraceParams);
+    }
+
+    // Same test as AFPSCharacter::IsWall
+    static bool IsWall(const FVector &Normal)
+    {
+        return Normal.Z >= -0.01 && Normal.Z <= 0.5;
+    }
+
+    bool TryAddLink(const FVector &Start, const FVector &Via, const FVector &Target, UClass *AreaClass)
+    {
+        FNavLocation End;
+        const float Snap = SampleSpacing * .5f;
+        if (!NavSys->ProjectPointToNavigation(Target, End, FVector(Snap, Snap, Limits.JumpHeight + Snap), NavData) ||
+            End.Location.Z - Start.Z > Limits.JumpHeight)
+        {
+            return false;
+        }
+        const double Distance = FVector::Dist(Start, End.Location);
+        if (Distance < SampleSpacing)
+        {
+            return false;
+        }
+
+        // Only worth a link when walking there is impossible or takes a long detour
+        const FPathFindingResult Walk =
+            NavSys->FindPathSync(FPathFindingQuery(Owner, *NavData, Start, End.Location, WalkFilter));
+        if (Walk.IsSuccessful() && Walk.Path.IsValid() && Walk.Path->GetLength() < Distance * DetourFactor)
+        {
+            return false;
+        }
+
+        // Neighbouring samples find the same move
+        for (const FNavigationLink &Link : Links)
+        {
+            if (Link.GetAreaClass() == AreaClass && FVector::Dist(Link.Left, Start) < SampleSpacing * 1.5f &&
+                FVector::Dist(Link.Right, End.Location) < SampleSpacing * 1.5f)
+            {
+                return false;
+            }
+        }
+
+        FNavigationLink &Link = Links.Emplace_GetRef(Start, End.Location);
+        Link.Direction = ENavLinkDirection::LeftToRight;
+        Link.SnapRadius = Snap;
+        Link.SetAreaClass(AreaClass);
+        ViaPoints.Add(Via);
+        return true;
+    }
+
+    void AddDoubleJumpLinks(const FVector &Start, const FVector &Direction)
+    {
+        const FVector Takeoff = Start + FVector::UpVector * Limits.CapsuleHalfHeight;
+        const FVector Apex = Takeoff + FVector::UpVector * Limits.JumpHeight;
+        if (IsBlocked(Takeoff, Apex))
+        {
+            return;
+        }
+        // Gaps at full reach and at half of it, the shorter one lands on ledges a full jump would overshoot
+        for (const float Reach : {ReachMargin, ReachMargin * .5f})
+        {
+            const FVector Target = Start + Direction * Limits.DoubleJumpDistance * Reach;
+            const FVector Over = Target + FVector::UpVector * (Limits.CapsuleHalfHeight + Limits.JumpHeight);
+            if (!IsBlocked(Apex, Over))
+            {
+                TryAddLink(Start, (Apex + Over) * .5f, Target, UFPSNavArea_DoubleJump::StaticClass());
+            }
+        }
+    }
+
+    void AddWallLinks(const FVector &Start, const FVector &Direction)
+    {
+        // Walls are looked for where a jump toward them would touch
+        const FVector Takeoff = Start + FVector::UpVector * Limits.CapsuleHalfHeight;
+        const FVector Reach = Takeoff + Direction * (Limits.CapsuleRadius + SampleSpacing);
+        FHitResult Wall;
+        if (!World->LineTraceSingleByChannel(Wall, Takeoff, Reach, Limits.WallChannel, TraceParams) ||
+            !IsWall(Wall.Normal))
+        {
+            return;
+        }
+        const FVector Normal = FVector::VectorPlaneProject(Wall.Normal, FVector::UpVector).GetSafeNormal();
+        const FVector Along = FVector::CrossProduct(Normal, FVector::UpVector);
+        const FVector RunStart = Wall.ImpactPoint + Normal * Limits.CapsuleRadius;
+
+        for (const float Side : {1.f, -1.f})
+        {
+            const FVector RunEnd = RunStart + Along * Side * Limits.WallRunDistance * ReachMargin;
+            // The wall has to go on for the whole run
+            const FVector RunMiddle = (RunStart + RunEnd) * .5f;
+            const FVector Probe = Normal * Limits.CapsuleRadius * 2;
+            if (IsBlocked(RunStart, RunEnd) || !IsBlocked(RunMiddle, RunMiddle - Probe) ||
+                !IsBlocked(RunEnd, RunEnd - Probe))
+            {
+                continue;
+            }
+            TryAddLink(Start, RunStart, RunEnd, UFPSNavArea_WallRun::StaticClass());
+
+            // Jumping off halfway through the run
+            const FVector JumpTarget = RunMiddle + Normal * Limits.WallJumpDistance * ReachMargin;
+            if (!IsBlocked(RunMiddle, JumpTarget + FVector::UpVector * Limits.CapsuleHalfHeight))
+            {
+                TryAddLink(Start, RunStart, JumpTarget, UFPSNavArea_WallJump::StaticClass());
+            }
+        }
+    }
+
+    void Generate(const FBox &Bounds)
+    {
+        const FVector Extent(SampleSpacing * .5f, SampleSpacing * .5f, Bounds.GetExtent().Z);
+        for (double X = Bounds.Min.X; X <= Bounds.Max.X; X += SampleSpacing)
+        {
+            for (double Y = Bounds.Min.Y; Y <= Bounds.Max.Y; Y += SampleSpacing)
+            {
+                FNavLocation Start;
+                if (!NavSys->ProjectPointToNavigation(FVector(X, Y, Bounds.GetCenter().Z), Start, Extent, NavData))
+                {
+                    continue;
+                }
+                for (int32 Angle = 0; Angle < 360; Angle += 45)
+                {
+                    const FVector Direction = FVector::ForwardVector.RotateAngleAxis(Angle, FVector::UpVector);
+                    AddDoubleJumpLinks(Start.Location, Direction);
+                    AddWallLinks(Start.Location, Direction);
+                }
+            }
+        }
+    }
+};
+
+AFPSParkourNavLinks::AFPSParkourNavLinks()
+{
+    PrimaryActorTick.bCanEverTick = false;
+    RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+    CharacterClass = AFPSCharacter::StaticClass();
+    SetCanBeDamaged(false);
+#if WITH_EDITORONLY_DATA
+    // Holds the links of the whole level, so it must stay loaded on World Partition maps
+    bIsSpatiallyLoaded = false;
+#endif
+}
+
+void AFPSParkourNavLinks::GenerateLinks()
+{
+    UWorld *World = GetWorld();
+    UNavigationSystemV1 *NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+    ANavigationData *NavData = NavSys ? NavSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate) : nullptr;
+    if (!NavData)
+    {
+        UE_LOG(LogMovementRemake, Warning, TEXT("Build navigation before generating parkour links"));
+        return;
+    }
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+
+    const AFPSCharacter *Character =
+        CharacterClass ? CharacterClass->GetDefaultObject<AFPSCharacter>() : GetDefault<AFPSCharacter>();
+    FParkourLinkGenerator Generator{this,
+                                    World,
+                                    NavSys,
+                                    NavData,
+                                    FParkourMoveLimits::FromCharacter(*Character, World->GetGravityZ()),
+                                    FMath::Max(SampleSpacing, 50.f),
+                                    DetourFactor,
+                                    ReachMargin,
+                                    NavData->GetDefaultQueryFilter()->GetCopy(),
+                                    FCollisionQueryParams(SCENE_QUERY_STAT(ParkourNavLinks), false, this)};
+    for (const UClass *AreaClass : {UFPSNavArea_DoubleJump::StaticClass(), UFPSNavArea_WallRun::StaticClass(),
+                                    UFPSNavArea_WallJump::StaticClass()})
+    {
+        const int32 AreaId = NavData->GetAreaID(AreaClass);
+        if (AreaId >= 0)
+        {
+            Generator.WalkFilter->SetExcludedArea(uint8(AreaId));
+        }
+    }
+    Generator.Generate(NavData->GetBounds());
+
+    Modify();
+    const FTransform &ActorTransform = GetActorTransform();
+    PointLinks = MoveTemp(Generator.Links);
+    LinkViaPoints = MoveTemp(Generator.ViaPoints);
+    for (int32 Index = 0; Index < PointLinks.Num(); Index++)
+    {
+        PointLinks[Index].Left = ActorTransform.InverseTransformPosition(PointLinks[Index].Left);
+        PointLinks[Index].Right = ActorTransform.InverseTransformPosition(PointLinks[Index].Right);
+        LinkViaPoints[Index] = ActorTransform.InverseTransformPosition(LinkViaPoints[Index]);
+    }
+    FNavigationSystem::UpdateActorData(*this);
+
+    UE_LOG(LogMovementRemake, Log, TEXT("Generated %d parkour nav links in %.2f s"), PointLinks.Num(),
+           FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles));
+}
+
+int32 AFPSParkourNavLinks::FindLink(const FVector &Start, const FVector &End, float Radius) const
+{
+    const FTransform &ActorTransform = GetActorTransform();
+    const FVector LocalStart = ActorTransform.InverseTransformPosition(Start);
+    const FVector LocalEnd = ActorTransform.InverseTransformPosition(End);
+    return PointLinks.IndexOfByPredicate([&LocalStart, &LocalEnd, Radius](const FNavigationLink &Link) {
+        return FVector::DistSquared(Link.Left, LocalStart) < Radius * Radius &&
+               FVector::DistSquared(Link.Right, LocalEnd) < Radius * Radius;
+    });
+}
+
+FVector AFPSParkourNavLinks::GetLinkViaPoint(int32 Index) const
+{
+    return GetActorTransform().TransformPosition(LinkViaPoints[Index]);
+}
+
+FVector AFPSParkourNavLinks::GetLinkEnd(int32 Index) const
+{
+    return GetActorTransform().TransformPosition(PointLinks[Index].Right);
+}
+
+UClass *AFPSParkourNavLinks::GetLinkArea(int32 Index) const
+{
+    return PointLinks[Index].GetAreaClass();
+}
+
+bool AFPSParkourNavLinks::GetNavigationLinksClasses(TArray<TSubclassOf<UNavLinkDefinition>> &OutClasses) const
+{
+    return false;
+}
+
+bool AFPSParkourNavLinks::GetNavigationLinksArray(TArray<FNavigationLink> &OutLink,
+                                                  TArray<FNavigationSegmentLink> &OutSegments) const
+{
+    OutLink.Append(PointLinks);
+    return PointLinks.Num() > 0;
+}
+
+void AFPSParkourNavLinks::GetNavigationData(FNavigationRelevantData &Data) const
+{
+    NavigationHelper::ProcessNavLinkAndAppend(&Data.Modifiers, this, PointLinks);
+}
+
+FBox AFPSParkourNavLinks::GetNavigationBounds() const
+{
+    FBox Bounds(ForceInit);
+    const FTransform &ActorTransform = GetActorTransform();
+    for (const FNavigationLink &Link : PointLinks)
+    {
+        Bounds += ActorTransform.TransformPosition(Link.Left);
+        Bounds += ActorTransform.TransformPosition(Link.Right);
+    }
+    return Bounds;
+}
+
+bool AFPSParkourNavLinks::IsNavigationRelevant() const
+{
+    return PointLinks.Num() > 0;
+}
+
+static FAutoConsoleCommandWithWorld GenerateParkourLinksCommand(
+    TEXT("fps.Nav.GenerateParkourLinks"),
+    TEXT("Regenerates the links of every AFPSParkourNavLinks in the level, adding one if there is none. Save the level "
+         "afterwards to keep them."),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld *World) {
+        if (!World)
+        {
+            return;
+        }
+        TActorIterator<AFPSParkourNavLinks> It(World);
+        if (!It)
+        {
+            if (AFPSParkourNavLinks *Links = World->SpawnActor<AFPSParkourNavLinks>())
+            {
+                Links->GenerateLinks();
+            }
+            return;
+        }
+        for (; It; ++It)
+        {
+            It->GenerateLinks();
+        }
+    }));
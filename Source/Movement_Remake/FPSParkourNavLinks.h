@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/Navigation/NavLinkDefinition.h"
+#include "AI/Navigation/NavRelevantInterface.h"
+#include "GameFramework/Actor.h"
+#include "NavAreas/NavArea.h"
+#include "NavFilters/NavigationQueryFilter.h"
+#include "NavLinkHostInterface.h"
+#include "FPSParkourNavLinks.generated.h"
+
+class AFPSCharacter;
+
+// Reach and duration of each parkour move, worked out from a character's movement settings the same way
+// AFPSCharacter applies the moves. Distances assume the move is started at walk speed.
+struct MOVEMENT_REMAKE_API FParkourMoveLimits
+{
+    float WalkSpeed = 0;
+    // Height reached by a jump followed by every air jump
+    float JumpHeight = 0;
+    // Air jumps available after leaving the ground, each pressed at the apex of the jump before
+    int32 AirJumps = 0;
+    float AirJumpDelay = 0;
+    float DoubleJumpDistance = 0;
+    float DoubleJumpTime = 0;
+    float WallRunDistance = 0;
+    float WallRunTime = 0;
+    float WallJumpDistance = 0;
+    float WallJumpTime = 0;
+    float CapsuleRadius = 0;
+    float CapsuleHalfHeight = 0;
+    TEnumAsByte<ECollisionChannel> WallChannel = ECC_Visibility;
+
+    static FParkourMoveLimits FromCharacter(const AFPSCharacter &Character, float GravityZ);
+
+    // Travel cost per unit of length relative to walking the same distance
+    float GetTimeCost(float Distance, float Time) const
+    {
+        return Time * WalkSpeed / FMath::Max(Distance, 1.f);
+    }
+};
+
+// Nav areas parkour links are tagged with, costs are set per character by UFPSParkourQueryFilter
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSNavArea_DoubleJump : public UNavArea
+{
+    GENERATED_BODY()
+
+public:
+    UFPSNavArea_DoubleJump();
+};
+
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSNavArea_WallRun : public UNavArea
+{
+    GENERATED_BODY()
+
+public:
+    UFPSNavArea_WallRun();
+};
+
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSNavArea_WallJump : public UNavArea
+{
+    GENERATED_BODY()
+
+public:
+    UFPSNavArea_WallJump();
+};
+
+/**
+ * Query filter that prices parkour links by how long the querier's character takes to perform them, scaled by a
+ * penalty for how easily the move fails.
+ */
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSParkourQueryFilter : public UNavigationQueryFilter
+{
+    GENERATED_BODY()
+
+public:
+    UFPSParkourQueryFilter();
+
+protected:
+    virtual void InitializeFilter(const ANavigationData &NavData, const UObject *Querier,
+                                  FNavigationQueryFilter &Filter) const override;
+
+private:
+    UPROPERTY(EditAnywhere, Category = "Parkour Nav")
+    float DoubleJumpPenalty = 1.5f;
+    UPROPERTY(EditAnywhere, Category = "Parkour Nav")
+    float WallRunPenalty = 2.f;
+    UPROPERTY(EditAnywhere, Category = "Parkour Nav")
+    float WallJumpPenalty = 2.5f;
+};
+
+/**
+ * Holds nav links for wall runs, wall jumps and double jump gaps, generated offline from the level geometry with the
+ * Generate Links button or fps.Nav.GenerateParkourLinks. Links go one way, from where the move starts to where the
+ * character lands.
+ */
+UCLASS()
+class MOVEMENT_REMAKE_API AFPSParkourNavLinks : public AActor, public INavLinkHostInterface, public INavRelevantInterface
+{
+    GENERATED_BODY()
+
+public:
+    AFPSParkourNavLinks();
+
+    // Samples the navmesh and adds a link wherever a parkour move reaches a spot that walking can't, or only by a
+    // long detour. Navigation has to be built first.
+    UFUNCTION(CallInEditor, Category = "Parkour Nav")
+    void GenerateLinks();
+
+    // Index of the link from within Radius of Start to within Radius of End, INDEX_NONE if there is none
+    int32 FindLink(const FVector &Start, const FVector &End, float Radius) const;
+    // World space point the move of a link passes through, the wall for wall moves
+    FVector GetLinkViaPoint(int32 Index) const;
+    FVector GetLinkEnd(int32 Index) const;
+    UClass *GetLinkArea(int32 Index) const;
+
+    // INavLinkHostInterface
+    virtual bool GetNavigationLinksClasses(TArray<TSubclassOf<UNavLinkDefinition>> &OutClasses) const override;
+    virtual bool GetNavigationLinksArray(TArray<FNavigationLink> &OutLink,
+                                         TArray<FNavigationSegmentLink> &OutSegments) const override;
+
+    // INavRelevantInterface
+    virtual void GetNavigationData(FNavigationRelevantData &Data) const override;
+    virtual FBox GetNavigationBounds() const override;
+    virtual bool IsNavigationRelevant() const override;
+
+private:
+    // Character whose movement settings decide how far each move reaches
+    UPROPERTY(EditAnywhere, Category = "Parkour Nav")
+    TSubclassOf<AFPSCharacter> CharacterClass;
+    // Distance between navmesh samples moves are tried from
+    UPROPERTY(EditAnywhere, Category = "Parkour Nav")
+    float SampleSpacing = 200.f;
+    // Walking has to be this many times longer than the move before a link is added
+    UPROPERTY(EditAnywhere, Category = "Parkour Nav")
+    float DetourFactor = 2.f;
+    // Share of the computed reach links are generated for, leaving a margin for imperfect takeoffs
+    UPROPERTY(EditAnywhere, Category = "Parkour Nav")
+    float ReachMargin = .85f;
+
+    // Links in actor space, with the point each move passes through at the same index
+    UPROPERTY(VisibleAnywhere, Category = "Parkour Nav")
+    TArray<FNavigationLink> PointLinks;
+    UPROPERTY()
+    TArray<FVector> LinkViaPoints;
+};
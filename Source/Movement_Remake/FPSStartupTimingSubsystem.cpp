@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FPSStartupTimingSubsystem.h"
+#include "Movement_Remake.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/WindowsHWrapper.h"
+#endif
+
+void UFPSStartupTimingSubsystem::Initialize(FSubsystemCollectionBase &Collection)
+{
+    Super::Initialize(Collection);
+
+    PreLoadMapHandle = FCoreUObjectDelegates::PreLoadMap.AddUObject(this, &UFPSStartupTimingSubsystem::OnPreLoadMap);
+    PostLoadMapHandle =
+        FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UFPSStartupTimingSubsystem::OnPostLoadMap);
+}
+
+void UFPSStartupTimingSubsystem::Deinitialize()
+{
+    FCoreUObjectDelegates::PreLoadMap.Remove(PreLoadMapHandle);
+    FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+
+    Super::Deinitialize();
+}
+
+uint64 UFPSStartupTimingSubsystem::GetProcessBytesRead()
+{
+#if PLATFORM_WINDOWS
+    IO_COUNTERS Counters;
+    if (GetProcessIoCounters(GetCurrentProcess(), &Counters))
+    {
+        return Counters.ReadTransferCount;
+    }
+#elif PLATFORM_LINUX
+    FString ProcIo;
+    if (FFileHelper::LoadFileToString(ProcIo, TEXT("/proc/self/io")))
+    {
+        uint64 Bytes = 0;
+        if (FParse::Value(*ProcIo, TEXT("rchar:"), Bytes))
+        {
+            return Bytes;
+        }
+    }
+#endif
+    return 0;
+}
+
+void UFPSStartupTimingSubsystem::OnPreLoadMap(const FString &MapName)
+{
+    LoadingMapName = MapName;
+    MapLoadStartTime = FPlatformTime::Seconds();
+    MapLoadStartBytes = GetProcessBytesRead();
+}
+
+void UFPSStartupTimingSubsystem::OnPostLoadMap(UWorld *LoadedWorld)
+{
+    const double Now = FPlatformTime::Seconds();
+    const uint64 BytesRead = GetProcessBytesRead();
+    const FString MapName = LoadedWorld ? LoadedWorld->GetMapName() : LoadingMapName;
+
+    if (MapLoadStartTime > 0)
+    {
+        Report(TEXT("MapLoad"), MapName, Now - MapLoadStartTime, BytesRead - MapLoadStartBytes);
+        if (!ComparePhase.IsEmpty())
+        {
+            UE_LOG(LogMovementRemake, Display, TEXT("%s %.3f ms, map reload %.3f ms (%.1fx)"), *ComparePhase,
+                   CompareSeconds * 1000, (Now - MapLoadStartTime) * 1000,
+                   (Now - MapLoadStartTime) / FMath::Max(CompareSeconds, 1e-9));
+            ComparePhase.Reset();
+            if (bQuitAfterCompare)
+            {
+                FPlatformMisc::RequestExit(false, TEXT("CompareWithMapReload"));
+            }
+        }
+        MapLoadStartTime = 0;
+    }
+    if (bWaitingForFirstMap)
+    {
+        bWaitingForFirstMap = false;
+        // GStartTime is taken when the process starts, so this covers engine init as well as the first map
+        Report(TEXT("Startup"), MapName, Now - GStartTime, BytesRead);
+
+        if (FParse::Param(FCommandLine::Get(), TEXT("StartupBenchmark")))
+        {
+            FPlatformMisc::RequestExit(false, TEXT("StartupBenchmark"));
+        }
+    }
+}
+
+void UFPSStartupTimingSubsystem::CompareWithMapReload(const TCHAR *Phase, double Seconds, bool bQuit)
+{
+    const UWorld *World = GetGameInstance()->GetWorld();
+    Report(Phase, World ? World->GetMapName() : FString(), Seconds, 0);
+    ComparePhase = Phase;
+    CompareSeconds = Seconds;
+    bQuitAfterCompare = bQuit;
+}
+
+void UFPSStartupTimingSubsystem::Report(const TCHAR *Phase, const FString &MapName, double Seconds, uint64 BytesRead)
+{
+    FString Label = TEXT("default");
+    FParse::Value(FCommandLine::Get(), TEXT("StartupLabel="), Label);
+
+    UE_LOG(LogMovementRemake, Display, TEXT("%s (%s) %s: %.3f s, %.1f MB read"), Phase, *Label, *MapName, Seconds,
+           BytesRead / (1024.0 * 1024.0));
+
+    const FString CsvPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / TEXT("Startup.csv");
+    FString Line;
+    if (IFileManager::Get().FileSize(*CsvPath) <= 0)
+    {
+        Line = TEXT("Label,Phase,Map,Seconds,BytesRead\n");
+    }
+    Line += FString::Printf(TEXT("%s,%s,%s,%.3f,%llu\n"), *Label, Phase, *MapName, Seconds, BytesRead);
+    FFileHelper::SaveStringToFile(Line, *CsvPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM,
+                                  &IFileManager::Get(), FILEWRITE_Append);
+}
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "FPSStartupTimingSubsystem.generated.h"
+
+/**
+ * Logs how long startup and each map load took and how many bytes the process read meanwhile.
+ * Results are appended to Saved/Benchmarks/Startup.csv, tagged with -StartupLabel=<Name>, so different package layouts
+ * can be compared. -StartupBenchmark quits as soon as the first map has loaded.
+ */
+UCLASS()
+class MOVEMENT_REMAKE_API UFPSStartupTimingSubsystem : public UGameInstanceSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase &Collection) override;
+    virtual void Deinitialize() override;
+
+    // Bytes read by this process so far, including reads served from the OS file cache
+    static uint64 GetProcessBytesRead();
+
+    // Reports an in-place alternative to reloading the map, such as a round reset, and logs it against the next map
+    // load. The caller starts that load. With bQuit the process exits once the map has loaded.
+    void CompareWithMapReload(const TCHAR *Phase, double Seconds, bool bQuit);
+
+private:
+    void OnPreLoadMap(const FString &MapName);
+    void OnPostLoadMap(UWorld *LoadedWorld);
+    void Report(const TCHAR *Phase, const FString &MapName, double Seconds, uint64 BytesRead);
+
+    // True until the first map has finished loading
+    bool bWaitingForFirstMap = true;
+    // Time and bytes read when the current map load started
+    double MapLoadStartTime = 0;
+    uint64 MapLoadStartBytes = 0;
+    FString LoadingMapName;
+    // Phase and time CompareWithMapReload logs the next map load against, empty when there is none
+    FString ComparePhase;
+    double CompareSeconds = 0;
+    bool bQuitAfterCompare = false;
+
+    FDelegateHandle PreLoadMapHandle;
+    FDelegateHandle PostLoadMapHandle;
+};
@@ -2,11 +2,13 @@
 
 
 #include "GunBase.h"
+#include "Movement_Remake.h"
 
 
 // Sets default values
 AGunBase::AGunBase()
 {
+	LLM_SCOPE_BYTAG(FPSWeapons);
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
@@ -22,6 +24,7 @@ AGunBase::AGunBase()
 // Called when the game starts or when spawned
 void AGunBase::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(FPSWeapons);
 	Super::BeginPlay();
 	
 }
@@ -29,6 +32,7 @@ void AGunBase::BeginPlay()
 // Called every frame
 void AGunBase::Tick(float DeltaTime)
 {
+	LLM_SCOPE_BYTAG(FPSWeapons);
 	Super::Tick(DeltaTime);
 
 }
@@ -0,0 +1,243 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AllocationCounter.h"
+#include "FPSCharacter.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/WorldSettings.h"
+#include "HAL/IConsoleManager.h"
+#include "InputActionValue.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Steady slide, wall run and air strafe frames must not allocate on the heap. Each test spawns a character in its own
+// world, drives it through the Walk, Look and Crouch input handlers and ticks the world, so movement, hits and the
+// character Tick all run as in a match. Allocations are counted by fps.Movement.AllocCheck, the same check that warns
+// in a running game. Run headless with:
+// UnrealEditor-Cmd <Project> -nullrhi -nosound -unattended -ExecCmds="Automation RunTests Movement_Remake; quit"
+class FMovementAllocationTest
+{
+public:
+    explicit FMovementAllocationTest(FAutomationTestBase &InTest);
+    ~FMovementAllocationTest();
+
+    bool RunSlide();
+    bool RunWallRun();
+    bool RunAirStrafe();
+
+private:
+    // Input action instance carrying a value, as Enhanced Input passes to the bound handlers
+    struct FTestInputInstance : public FInputActionInstance
+    {
+        explicit FTestInputInstance(const FInputActionValue &InValue)
+        {
+            Value = InValue;
+        }
+    };
+
+    static constexpr float DeltaTime = 1.f / 60.f;
+    // Frames that may allocate while the character settles into the state under test
+    static constexpr int32 SettleFrames = 30;
+    // Steady frames that must not allocate
+    static constexpr int32 CheckedFrames = 300;
+
+    AStaticMeshActor *SpawnBox(const FVector &Location, const FVector &Scale);
+    bool SpawnCharacter(const FVector &Location, const FVector &Velocity);
+    void Frame(const FVector &WalkInput, const FVector2D &LookInput);
+    // Ticks SettleFrames, checks the state reached, then fails if any of CheckedFrames allocates
+    bool CheckSteadyFrames(const TCHAR *StateName, TFunctionRef<bool()> IsInState, const FVector &WalkInput,
+                           const FVector2D &LookInput);
+
+    FAutomationTestBase &Test;
+    UWorld *World = nullptr;
+    AFPSCharacter *Character = nullptr;
+    IConsoleVariable *AllocCheck = nullptr;
+    bool bAllocCheckWasOn = false;
+};
+
+FMovementAllocationTest::FMovementAllocationTest(FAutomationTestBase &InTest) : Test(InTest)
+{
+    World = UWorld::CreateWorld(EWorldType::Game, /* bInformEngineOfWorld = */ false,
+                                TEXT("MovementAllocationTestWorld"));
+    FWorldContext &Context = GEngine->CreateNewWorldContext(EWorldType::Game);
+    Context.SetCurrentWorld(World);
+    World->InitializeActorsForPlay(FURL());
+    // There is no game mode to start play, so actors are begun directly
+    World->GetWorldSettings()->NotifyBeginPlay();
+
+    AllocCheck = IConsoleManager::Get().FindConsoleVariable(TEXT("fps.Movement.AllocCheck"));
+    if (AllocCheck)
+    {
+        bAllocCheckWasOn = AllocCheck->GetBool();
+        // Console priority, so a value set at the console or in an ini can't keep the check off
+        AllocCheck->Set(true, ECVF_SetByConsole);
+    }
+
+    // Floor top at z 50, and a wall along the x axis with its face at y 150
+    SpawnBox(FVector(0, 0, 0), FVector(2000, 2000, 1));
+    SpawnBox(FVector(0, 200, 50000), FVector(2000, 1, 1000));
+}
+
+FMovementAllocationTest::~FMovementAllocationTest()
+{
+    if (AllocCheck)
+    {
+        AllocCheck->Set(bAllocCheckWasOn, ECVF_SetByConsole);
+    }
+    GEngine->DestroyWorldContext(World);
+    World->DestroyWorld(/* bInformEngineOfWorld = */ false);
+}
+
+AStaticMeshActor *FMovementAllocationTest::SpawnBox(const FVector &Location, const FVector &Scale)
+{
+    AStaticMeshActor *Box = World->SpawnActor<AStaticMeshActor>(Location, FRotator::ZeroRotator);
+    UStaticMeshComponent *Mesh = Box->GetStaticMeshComponent();
+    Mesh->SetMobility(EComponentMobility::Movable);
+    Mesh->SetStaticMesh(LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube")));
+    Box->SetActorScale3D(Scale);
+    return Box;
+}
+
+bool FMovementAllocationTest::SpawnCharacter(const FVector &Location, const FVector &Velocity)
+{
+    if (!FScopedAllocationCounter::IsSupported() || !AllocCheck)
+    {
+        Test.AddError(TEXT("Heap allocations can't be counted in this build"));
+        return false;
+    }
+    if (!AllocCheck->GetBool())
+    {
+        Test.AddError(TEXT("fps.Movement.AllocCheck could not be turned on, so nothing would be counted"));
+        return false;
+    }
+    FActorSpawnParameters SpawnParams;
+    SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+    Character = World->SpawnActor<AFPSCharacter>(AFPSCharacter::StaticClass(), FTransform(Location), SpawnParams);
+    if (!Character)
+    {
+        Test.AddError(TEXT("Could not spawn a character"));
+        return false;
+    }
+    // A controller makes the Look handler turn the view as it does for a player
+    World->SpawnActor<APlayerController>()->Possess(Character);
+    Character->GetCharacterMovement()->Velocity = Velocity;
+    return true;
+}
+
+void FMovementAllocationTest::Frame(const FVector &WalkInput, const FVector2D &LookInput)
+{
+    Character->Walk(FTestInputInstance(FInputActionValue(WalkInput)));
+    Character->Look(FTestInputInstance(FInputActionValue(LookInput)));
+    World->Tick(LEVELTICK_All, DeltaTime);
+}
+
+bool FMovementAllocationTest::CheckSteadyFrames(const TCHAR *StateName, TFunctionRef<bool()> IsInState,
+                                                const FVector &WalkInput, const FVector2D &LookInput)
+{
+    for (int32 i = 0; i < SettleFrames; i++)
+    {
+        Frame(WalkInput, LookInput);
+    }
+    if (!IsInState())
+    {
+        Test.AddError(FString::Printf(TEXT("Character did not reach a %s: %s"), StateName,
+                                      *Character->DescribeMovementState()));
+        return false;
+    }
+
+    Character->SteadyFrameAllocations = 0;
+    int32 Frames = 0;
+    for (; Frames < CheckedFrames && IsInState(); Frames++)
+    {
+        Frame(WalkInput, LookInput);
+    }
+    if (Frames < CheckedFrames)
+    {
+        Test.AddError(FString::Printf(TEXT("Character left the %s after %d frames: %s"), StateName, Frames,
+                                      *Character->DescribeMovementState()));
+    }
+    if (Character->SteadyFrameAllocations > 0)
+    {
+        Test.AddError(FString::Printf(TEXT("%lld heap allocations over %d steady %s frames"),
+                                      Character->SteadyFrameAllocations, Frames, StateName));
+    }
+    return !Test.HasAnyErrors();
+}
+
+bool FMovementAllocationTest::RunSlide()
+{
+    if (!SpawnCharacter(FVector(-50000, -20000, 200), FVector::ZeroVector))
+    {
+        return false;
+    }
+    const FVector Forward(0, 1, 0);
+    // Walks up to full speed, then crouches into a slide
+    for (int32 i = 0; i < 60; i++)
+    {
+        Frame(Forward, FVector2D::ZeroVector);
+    }
+    Character->StartCrouch(FTestInputInstance(FInputActionValue(true)));
+    return CheckSteadyFrames(
+        TEXT("slide"),
+        [this]() {
+            return Character->bIsCrouching && Character->bAppliedSlideForce &&
+                   Character->GetCharacterMovement()->IsMovingOnGround();
+        },
+        Forward, FVector2D::ZeroVector);
+}
+
+bool FMovementAllocationTest::RunWallRun()
+{
+    // Falling beside the wall, moving along it and into it
+    if (!SpawnCharacter(FVector(-50000, 110, 80000), FVector(1000, 100, 0)))
+    {
+        return false;
+    }
+    return CheckSteadyFrames(
+        TEXT("wall run"), [this]() { return Character->bIsWallrunning; }, FVector(.3, 1, 0), FVector2D::ZeroVector);
+}
+
+bool FMovementAllocationTest::RunAirStrafe()
+{
+    if (!SpawnCharacter(FVector(0, -50000, 80000), FVector(1000, 0, 0)))
+    {
+        return false;
+    }
+    return CheckSteadyFrames(
+        TEXT("air strafe"),
+        [this]() { return Character->GetCharacterMovement()->IsFalling() && !Character->bIsWallrunning; },
+        FVector(1, 1, 0), FVector2D(1, 0));
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMovementSlideAllocationTest, "Movement_Remake.Movement.SteadyAllocations.Slide",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                     EAutomationTestFlags::ProductFilter)
+bool FMovementSlideAllocationTest::RunTest(const FString &Parameters)
+{
+    return FMovementAllocationTest(*this).RunSlide();
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMovementWallRunAllocationTest, "Movement_Remake.Movement.SteadyAllocations.WallRun",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                     EAutomationTestFlags::ProductFilter)
+bool FMovementWallRunAllocationTest::RunTest(const FString &Parameters)
+{
+    return FMovementAllocationTest(*this).RunWallRun();
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMovementAirStrafeAllocationTest,
+                                 "Movement_Remake.Movement.SteadyAllocations.AirStrafe",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                     EAutomationTestFlags::ProductFilter)
+bool FMovementAirStrafeAllocationTest::RunTest(const FString &Parameters)
+{
+    return FMovementAllocationTest(*this).RunAirStrafe();
+}
+
+#endif
@@ -0,0 +1,294 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AllocationCounter.h"
+#include "FPSCharacter.h"
+#include "Movement_Remake.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+// Microbenchmarks for the movement math in AFPSCharacter.
+//
+// Usage: fps.Movement.Bench [Iterations] [Seed] [-UpdateBaseline] [quit]
+// Headless: UnrealEditor-Cmd <Project> -game -nullrhi -nosound -ExecCmds="fps.Movement.Bench 2000000 quit"
+//
+// Each case runs over pre-generated random inputs so that only the function under test is timed and counted.
+// Results are logged as ns/op and allocations/op and written to Saved/Benchmarks/MovementBench-<time>.csv. They are
+// compared with the baseline in Benchmarks/MovementBench.csv, and the run fails if there is no baseline or a case got
+// slower than RegressionTolerance or allocates more. With quit a failed run exits with status 1, so it can run in CI.
+// The baseline only changes when -UpdateBaseline is passed to the command or on the command line, so slow creep over
+// many runs still shows up against it.
+class FMovementBenchmark
+{
+public:
+    static void Run(const TArray<FString> &Args, UWorld *World);
+
+private:
+    struct FResult
+    {
+        FString Name;
+        double NsPerOp = 0;
+        double AllocsPerOp = 0;
+    };
+
+    // One set of random inputs shared by all cases
+    struct FInput
+    {
+        FVector Vector;
+        FVector Normal;
+        FVector Velocity;
+        double Yaw;
+        double Pitch;
+        double Roll;
+        float DeltaTime;
+        float Magnitude;
+    };
+
+    // Input arrays are capped so they stay in cache and iterations wrap around them
+    static constexpr int32 MaxInputs = 1 << 16;
+    // Relative ns/op increase over the baseline that is reported as a regression
+    static constexpr double RegressionTolerance = .2;
+
+    static AFPSCharacter *SpawnCharacter(UWorld *World);
+    template <typename FunctionType>
+    static FResult Measure(const TCHAR *Name, int32 Iterations, FunctionType &&Function);
+    static TMap<FString, FResult> LoadBaseline(const FString &Path);
+    static void SaveResults(const FString &Path, const TArray<FResult> &Results);
+};
+
+template <typename FunctionType>
+FMovementBenchmark::FResult FMovementBenchmark::Measure(const TCHAR *Name, int32 Iterations, FunctionType &&Function)
+{
+    // Warm up caches and branch predictors before timing
+    for (int32 i = 0; i < FMath::Min(Iterations, 1024); i++)
+    {
+        Function(i & (MaxInputs - 1));
+    }
+
+    FScopedAllocationCounter Allocations;
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    for (int32 i = 0; i < Iterations; i++)
+    {
+        Function(i & (MaxInputs - 1));
+    }
+    const uint64 EndCycles = FPlatformTime::Cycles64();
+
+    FResult Result;
+    Result.Name = Name;
+    Result.NsPerOp = FPlatformTime::ToMilliseconds64(EndCycles - StartCycles) * 1e6 / Iterations;
+    Result.AllocsPerOp = double(Allocations.Num()) / Iterations;
+    return Result;
+}
+
+// Spawns a transient character far away from the level so collision and overlaps don't interfere
+AFPSCharacter *FMovementBenchmark::SpawnCharacter(UWorld *World)
+{
+    if (!World)
+    {
+        UE_LOG(LogMovementRemake, Error, TEXT("Movement benchmarks need a world to spawn a character in"));
+        return nullptr;
+    }
+    FActorSpawnParameters SpawnParams;
+    SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+    SpawnParams.ObjectFlags |= RF_Transient;
+    AFPSCharacter *Character = World->SpawnActor<AFPSCharacter>(AFPSCharacter::StaticClass(),
+                                                                FTransform(FVector(0, 0, -100000)), SpawnParams);
+    if (!Character)
+    {
+        UE_LOG(LogMovementRemake, Error, TEXT("Movement benchmarks could not spawn a character"));
+    }
+    return Character;
+}
+
+void FMovementBenchmark::Run(const TArray<FString> &Args, UWorld *World)
+{
+    TArray<FString> Numbers = Args.FilterByPredicate([](const FString &Arg) { return Arg.IsNumeric(); });
+    const int32 Iterations = Numbers.Num() > 0 ? FMath::Max(FCString::Atoi(*Numbers[0]), 1) : 1000000;
+    const int32 Seed = Numbers.Num() > 1 ? FCString::Atoi(*Numbers[1]) : 1337;
+    const bool bUpdateBaseline =
+        Args.Contains(TEXT("-UpdateBaseline")) || FParse::Param(FCommandLine::Get(), TEXT("UpdateBaseline"));
+    const bool bQuit = Args.Contains(TEXT("quit"));
+
+    AFPSCharacter *Character = SpawnCharacter(World);
+    if (!Character)
+    {
+        if (bQuit)
+        {
+            FPlatformMisc::RequestExitWithStatus(false, 1);
+        }
+        return;
+    }
+    // Keeps on-screen debug messages out of the timed cases
+    Character->bCosmeticsEnabled = false;
+    UCharacterMovementComponent *Movement = Character->GetCharacterMovement();
+
+    FRandomStream Random(Seed);
+    TArray<FInput> Inputs;
+    Inputs.SetNumUninitialized(MaxInputs);
+    for (FInput &Input : Inputs)
+    {
+        Input.Vector = Random.GetUnitVector() * Random.FRandRange(0, 1000);
+        Input.Normal = Random.GetUnitVector();
+        Input.Velocity = Random.GetUnitVector() * Random.FRandRange(0, 2000);
+        Input.Yaw = Random.FRandRange(-PI, PI);
+        Input.Pitch = Random.FRandRange(-PI, PI);
+        Input.Roll = Random.FRandRange(-PI, PI);
+        Input.DeltaTime = Random.FRandRange(1.f / 240.f, 1.f / 20.f);
+        Input.Magnitude = Random.FRandRange(0, Character->GradualSlideForce);
+    }
+
+    // Keeps results alive so the optimiser can't drop the calls
+    volatile double Sink = 0;
+    TArray<FResult> Results;
+
+    Results.Add(Measure(TEXT("VectorRotate"), Iterations, [&](int32 i) {
+        const FInput &Input = Inputs[i];
+        Sink = Sink + Character->VectorRotate(Input.Vector, Input.Yaw, Input.Pitch, Input.Roll).X;
+    }));
+    // Constant rotation used by StartWallRun
+    Results.Add(Measure(TEXT("VectorRotateHalfPi"), Iterations, [&](int32 i) {
+        Sink = Sink + Character->VectorRotate(Inputs[i].Normal, PI / 2.0, 0, 0).X;
+    }));
+    Results.Add(Measure(TEXT("IsWall"), Iterations, [&](int32 i) {
+        Sink = Sink + Character->IsWall(Inputs[i].Normal);
+    }));
+    Results.Add(Measure(TEXT("AirAccelerate"), Iterations, [&](int32 i) {
+        const FInput &Input = Inputs[i];
+        Movement->Velocity = Input.Velocity;
+        Character->WalkingInput = Input.Vector;
+        Character->AirAccelerate(Input.Vector);
+        Sink = Sink + Movement->Velocity.X;
+    }));
+    Results.Add(Measure(TEXT("GradualSlide"), Iterations, [&](int32 i) {
+        const FInput &Input = Inputs[i];
+        Movement->Velocity = Input.Velocity;
+        Character->AddVelocityMag = Input.Magnitude;
+        Sink = Sink + Character->GradualSlide(Input.DeltaTime);
+    }));
+    Results.Add(Measure(TEXT("WallRun"), Iterations, [&](int32 i) {
+        const FInput &Input = Inputs[i];
+        Movement->Velocity = Input.Velocity;
+        Character->WallNormalVector = Input.Normal;
+        Character->WallPerpendicularNormalVector = Input.Vector.GetSafeNormal();
+        Character->WallRun(Input.DeltaTime);
+        Sink = Sink + Movement->Velocity.X;
+    }));
+    Results.Add(Measure(TEXT("SlopeSlide"), Iterations, [&](int32 i) {
+        const FInput &Input = Inputs[i];
+        Movement->Velocity = Input.Velocity;
+        Movement->CurrentFloor.HitResult.Normal = Input.Normal;
+        Character->SlopeSlide(Input.DeltaTime);
+        Sink = Sink + Movement->Velocity.X;
+    }));
+
+    Character->Destroy();
+
+    const FString BaselinePath = FPaths::ProjectDir() / TEXT("Benchmarks") / TEXT("MovementBench.csv");
+    const TMap<FString, FResult> Baseline = LoadBaseline(BaselinePath);
+    // Recording a baseline never fails, everything else is checked against it
+    int32 Failures = 0;
+    if (Baseline.IsEmpty() && !bUpdateBaseline)
+    {
+        UE_LOG(LogMovementRemake, Error, TEXT("No movement benchmark baseline at %s, run with -UpdateBaseline to "
+                                              "record one"), *BaselinePath);
+        Failures++;
+    }
+
+    UE_LOG(LogMovementRemake, Display, TEXT("Movement benchmark: %d iterations, seed %d%s"), Iterations, Seed,
+           FScopedAllocationCounter::IsSupported() ? TEXT("") : TEXT(", allocations not counted in this build"));
+    for (const FResult &Result : Results)
+    {
+        UE_LOG(LogMovementRemake, Display, TEXT("  %-20s %10.2f ns/op %8.3f allocs/op"), *Result.Name, Result.NsPerOp,
+               Result.AllocsPerOp);
+        if (bUpdateBaseline || Baseline.IsEmpty())
+        {
+            continue;
+        }
+        const FResult *Previous = Baseline.Find(Result.Name);
+        if (!Previous)
+        {
+            UE_LOG(LogMovementRemake, Error, TEXT("  %s is missing from the baseline"), *Result.Name);
+            Failures++;
+            continue;
+        }
+        if (Result.NsPerOp > Previous->NsPerOp * (1 + RegressionTolerance))
+        {
+            UE_LOG(LogMovementRemake, Error, TEXT("  %s regressed: %.2f ns/op, baseline %.2f ns/op"), *Result.Name,
+                   Result.NsPerOp, Previous->NsPerOp);
+            Failures++;
+        }
+        if (Result.AllocsPerOp > Previous->AllocsPerOp)
+        {
+            UE_LOG(LogMovementRemake, Error, TEXT("  %s allocates more: %.3f allocs/op, baseline %.3f allocs/op"),
+                   *Result.Name, Result.AllocsPerOp, Previous->AllocsPerOp);
+            Failures++;
+        }
+    }
+    SaveResults(FPaths::ProjectSavedDir() / TEXT("Benchmarks") /
+                    FString::Printf(TEXT("MovementBench-%s.csv"), *FDateTime::Now().ToString()),
+                Results);
+    if (bUpdateBaseline)
+    {
+        SaveResults(BaselinePath, Results);
+    }
+
+    if (Failures > 0)
+    {
+        UE_LOG(LogMovementRemake, Error, TEXT("Movement benchmark failed %d checks against %s"), Failures,
+               *BaselinePath);
+    }
+    if (bQuit)
+    {
+        FPlatformMisc::RequestExitWithStatus(false, Failures > 0 ? 1 : 0);
+    }
+}
+
+TMap<FString, FMovementBenchmark::FResult> FMovementBenchmark::LoadBaseline(const FString &Path)
+{
+    TMap<FString, FResult> Baseline;
+    TArray<FString> Lines;
+    if (!FFileHelper::LoadFileToStringArray(Lines, *Path))
+    {
+        return Baseline;
+    }
+    // First line is the header
+    for (int32 i = 1; i < Lines.Num(); i++)
+    {
+        TArray<FString> Columns;
+        if (Lines[i].ParseIntoArray(Columns, TEXT(",")) == 3)
+        {
+            FResult Result;
+            Result.Name = Columns[0];
+            Result.NsPerOp = FCString::Atod(*Columns[1]);
+            Result.AllocsPerOp = FCString::Atod(*Columns[2]);
+            Baseline.Add(Result.Name, Result);
+        }
+    }
+    return Baseline;
+}
+
+void FMovementBenchmark::SaveResults(const FString &Path, const TArray<FResult> &Results)
+{
+    FString Csv = TEXT("Name,NsPerOp,AllocsPerOp\n");
+    for (const FResult &Result : Results)
+    {
+        Csv += FString::Printf(TEXT("%s,%.3f,%.4f\n"), *Result.Name, Result.NsPerOp, Result.AllocsPerOp);
+    }
+    if (FFileHelper::SaveStringToFile(Csv, *Path))
+    {
+        UE_LOG(LogMovementRemake, Display, TEXT("Movement benchmark results written to %s"), *Path);
+    }
+}
+
+static FAutoConsoleCommandWithWorldAndArgs MovementBenchCommand(
+    TEXT("fps.Movement.Bench"),
+    TEXT("Benchmarks the movement math. Usage: fps.Movement.Bench [Iterations] [Seed] [-UpdateBaseline] [quit]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&FMovementBenchmark::Run));
@@ -3,4 +3,10 @@
 #include "Movement_Remake.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogMovementRemake);
+
+LLM_DEFINE_TAG(FPSMovement);
+LLM_DEFINE_TAG(FPSWeapons);
+LLM_DEFINE_TAG(FPSEffects);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, Movement_Remake, "Movement_Remake" );
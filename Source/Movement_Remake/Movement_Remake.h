@@ -3,4 +3,11 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogMovementRemake, Log, All);
+
+// Low level memory tracker tags, visible with -llm in stat LLM and memreport
+LLM_DECLARE_TAG_API(FPSMovement, MOVEMENT_REMAKE_API);
+LLM_DECLARE_TAG_API(FPSWeapons, MOVEMENT_REMAKE_API);
+LLM_DECLARE_TAG_API(FPSEffects, MOVEMENT_REMAKE_API);